@@ -0,0 +1,187 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * @brief Generates the abelian groups of an order directly, without
+ * search. By the fundamental theorem each one is isomorphic to exactly
+ * one Z_d1 x Z_d2 x ... x Z_dk, where d1 | d2 | ... | dk and their
+ * product is the order (invariant factors).
+ *
+ * The decompositions come from the partitions of the exponents in
+ * the prime factorization: the i-th largest invariant factor is the
+ * product of the i-th largest prime powers.
+ */
+class AbelianGroups {
+    private:
+        /**
+         * @brief All partitions of n into parts not greater than "max",
+         * in decreasing order of the parts.
+         */
+        static void Partitions(int n, int max, std::vector<int> &current,
+            std::vector<std::vector<int>> &result) {
+
+            if (n == 0) {
+                result.push_back(current);
+                return;
+            }
+
+            for(int part = (max < n ? max : n); part >= 1; part--) {
+                current.push_back(part);
+                AbelianGroups::Partitions(n - part, part, current, result);
+                current.pop_back();
+            }
+        }
+
+        /**
+         * @brief Combines the exponent partitions of the primes from
+         * "index" on into invariant factors.
+         */
+        static void Combine(const std::vector<int> &primes, const std::vector<std::vector<std::vector<int>>> &partitions,
+            int index, std::vector<int> &factors, std::vector<std::vector<int>> &result) {
+
+            if (index == (int)primes.size()) {
+                // Increasing order: d1 | d2 | ... | dk
+                result.push_back(std::vector<int>(factors.rbegin(), factors.rend()));
+                return;
+            }
+
+            for(const std::vector<int> &partition : partitions[index]) {
+                std::vector<int> extended = factors;
+
+                if (extended.size() < partition.size()) {
+                    extended.resize(partition.size(), 1);
+                }
+
+                for(int i = 0; i < (int)partition.size(); i++) {
+                    for(int e = 0; e < partition[i]; e++) {
+                        extended[i] *= primes[index];
+                    }
+                }
+
+                AbelianGroups::Combine(primes, partitions, index + 1, extended, result);
+            }
+        }
+
+    public:
+        /**
+         * @brief Returns the invariant factors of each abelian group
+         * of the given order, in increasing order within each list.
+         * (Order 1: a single empty list.)
+         */
+        static std::vector<std::vector<int>> InvariantFactors(int order) {
+            if (order < 1) {
+                throw std::runtime_error("Invalid order value. It has to be positive.");
+            }
+
+            std::vector<int> primes;
+            std::vector<std::vector<std::vector<int>>> partitions;
+            int rest = order;
+
+            for(int p = 2; rest > 1; p++) {
+                if (p * p > rest) {
+                    // The rest is a prime
+                    p = rest;
+                }
+
+                int exponent = 0;
+
+                while(rest % p == 0) {
+                    rest /= p;
+                    exponent++;
+                }
+
+                if (exponent > 0) {
+                    std::vector<int> current;
+                    primes.push_back(p);
+                    partitions.push_back(std::vector<std::vector<int>>());
+                    AbelianGroups::Partitions(exponent, exponent, current, partitions.back());
+                }
+            }
+
+            std::vector<std::vector<int>> result;
+            std::vector<int> factors;
+            AbelianGroups::Combine(primes, partitions, 0, factors, result);
+
+            return result;
+        }
+
+        /**
+         * @brief Builds the Cayley table of Z_d1 x ... x Z_dk. The elements
+         * are numbered in mixed radix (the first factor is the lowest digit),
+         * so the identity is element 1, and the first row and column are
+         * in order, as in the tables of the search algorithms.
+         */
+        static std::vector<uint8_t> Table(const std::vector<int> &factors) {
+            int order = 1;
+
+            for(int d : factors) {
+                order *= d;
+            }
+
+            if (order > 255) {
+                throw std::runtime_error("The order is too large for a Cayley table. Allowed: 1 -> 255");
+            }
+
+            std::vector<uint8_t> cayley(order * order);
+
+            for(int a = 0; a < order; a++) {
+                for(int b = 0; b < order; b++) {
+                    int restA = a;
+                    int restB = b;
+                    int product = 0;
+                    int weight = 1;
+
+                    for(int d : factors) {
+                        product += ((restA % d + restB % d) % d) * weight;
+                        restA /= d;
+                        restB /= d;
+                        weight *= d;
+                    }
+
+                    cayley[a * order + b] = product + 1;
+                }
+            }
+
+            return cayley;
+        }
+
+        /**
+         * @brief Name of the group, for example "Z2 x Z4".
+         */
+        static std::string Name(const std::vector<int> &factors) {
+            if (factors.empty()) {
+                return "Z1";
+            }
+
+            std::string result;
+
+            for(int i = 0; i < (int)factors.size(); i++) {
+                if (i > 0) {
+                    result += " x ";
+                }
+
+                result += "Z" + std::to_string(factors[i]);
+            }
+
+            return result;
+        }
+};
@@ -0,0 +1,257 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include "SearchTrail.hpp"
+
+/**
+ * @brief All-different filtering for the rows and columns of a
+ * partial Latin square. (Régin's algorithm over bitmap domains.)
+ *
+ * In each row (and column) the free cells have to take exactly the
+ * missing values, so a perfect matching between them must exist.
+ * If there is none (a Hall violation), the partial table is dead.
+ * Otherwise a value is only kept in the domain of a cell if the
+ * edge is in some perfect matching: either it is in the current
+ * matching or it is on an alternating cycle.
+ *
+ * The domain of a free cell is everything not used in its row or
+ * column and not pruned yet. The pruned values are stored in the
+ * bitmaps of a SearchTrail, so backtracking restores them.
+ */
+class AllDifferent {
+    private:
+        int order;
+        uint8_t *hints;             // Value of each cell in the last matching + 1. (Warm start.)
+
+        /*
+            State of a single line
+        */
+        int count;                  // Number of free cells.
+        int cells[32];              // Positions of the free cells.
+        uint32_t domains[32];
+        int cellValue[32];          // Matched value of each free cell.
+        int valueCell[32];          // Matched cell index of each value, -1 if none.
+
+        uint64_t lines;
+        uint64_t failures;
+        uint64_t pruned;
+
+        /**
+         * @brief Kuhn's augmenting path search from a cell.
+         */
+        bool Augment(int cell, uint32_t &visited) {
+            uint32_t candidates = this->domains[cell] & ~visited;
+
+            while(candidates) {
+                int value = __builtin_ctz(candidates);
+                candidates &= candidates - 1;
+                visited |= ((uint32_t)1) << value;
+
+                if (this->valueCell[value] < 0 || this->Augment(this->valueCell[value], visited)) {
+                    this->valueCell[value] = cell;
+                    this->cellValue[cell] = value;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Filters the domains of the free cells of the current
+         * line. The missing values of the line are exactly as many as
+         * the free cells.
+         *
+         * @return False if there is no perfect matching.
+         */
+        bool FilterLine() {
+            for(int v = 0; v < this->order; v++) {
+                this->valueCell[v] = -1;
+            }
+
+            /*
+                Warm start from the previous matching
+            */
+            for(int c = 0; c < this->count; c++) {
+                int hint = this->hints[this->cells[c]] - 1;
+                this->cellValue[c] = -1;
+
+                if (hint >= 0 && (this->domains[c] & (((uint32_t)1) << hint)) && this->valueCell[hint] < 0) {
+                    this->cellValue[c] = hint;
+                    this->valueCell[hint] = c;
+                }
+            }
+
+            for(int c = 0; c < this->count; c++) {
+                if (this->cellValue[c] >= 0) {
+                    continue;
+                }
+
+                uint32_t visited = 0;
+
+                if (!this->Augment(c, visited)) {
+                    return false;
+                }
+            }
+
+            for(int c = 0; c < this->count; c++) {
+                this->hints[this->cells[c]] = this->cellValue[c] + 1;
+            }
+
+            /*
+                The matching is perfect, so every missing value is matched.
+                Value graph: v -> w if the cell of v can take w. The edge
+                (cell of v, w) is in an alternating cycle if w reaches v.
+            */
+            uint32_t reach[32];
+            uint32_t values = 0;
+
+            for(int c = 0; c < this->count; c++) {
+                reach[this->cellValue[c]] = this->domains[c];
+                values |= ((uint32_t)1) << this->cellValue[c];
+            }
+
+            for(uint32_t ks = values; ks; ks &= ks - 1) {
+                int k = __builtin_ctz(ks);
+                uint32_t kBit = ((uint32_t)1) << k;
+
+                for(uint32_t vs = values; vs; vs &= vs - 1) {
+                    int v = __builtin_ctz(vs);
+
+                    if (reach[v] & kBit) {
+                        reach[v] |= reach[k];
+                    }
+                }
+            }
+
+            for(int c = 0; c < this->count; c++) {
+                uint32_t own = ((uint32_t)1) << this->cellValue[c];
+                uint32_t keep = own;
+
+                for(uint32_t ws = this->domains[c] & ~own; ws; ws &= ws - 1) {
+                    int w = __builtin_ctz(ws);
+
+                    if (reach[w] & own) {
+                        keep |= ((uint32_t)1) << w;
+                    }
+                }
+
+                this->domains[c] &= keep;
+            }
+
+            return true;
+        }
+
+    public:
+        AllDifferent(int order) : order(order), lines(0), failures(0), pruned(0) {
+            this->hints = new uint8_t[order * order];
+            memset(this->hints, 0, order * order);
+        }
+
+        ~AllDifferent() {
+            delete[] this->hints;
+        }
+
+        /**
+         * @brief Filters the lines affected by the assignment of the
+         * cell (x, y) until nothing changes: its row and column, and
+         * the lines crossing them, since their domains shrank too.
+         * The removed values are added to the pruned bitmaps of the
+         * cells in the trail: masks[prunedBase + position].
+         * The row bitmaps are masks[0 .. order), the column bitmaps
+         * are masks[order .. 2 * order).
+         *
+         * @return False if a row or column can't be completed.
+         */
+        bool Propagate(SearchTrail &trail, const uint8_t *cayley, int prunedBase, int x, int y) {
+            uint32_t *masks = trail.GetMasks();
+            uint32_t full = (((uint64_t)1) << this->order) - 1;
+            uint64_t pending = 0;   // Bit "line": rows 0 .. order - 1, then the columns.
+
+            for(int i = 0; i < this->order; i++) {
+                if (cayley[y * this->order + i] == 0) {
+                    pending |= ((uint64_t)1) << (this->order + i);
+                }
+
+                if (cayley[i * this->order + x] == 0) {
+                    pending |= ((uint64_t)1) << i;
+                }
+            }
+
+            pending |= (((uint64_t)1) << y) | (((uint64_t)1) << (this->order + x));
+
+            while(pending) {
+                int line = __builtin_ctzll(pending);
+                bool isRow = line < this->order;
+                int index = isRow ? line : line - this->order;
+                pending &= pending - 1;
+                this->count = 0;
+
+                for(int i = 0; i < this->order; i++) {
+                    int cellX = isRow ? i : index;
+                    int cellY = isRow ? index : i;
+                    int pos = cellY * this->order + cellX;
+
+                    if (cayley[pos] != 0) {
+                        continue;
+                    }
+
+                    this->cells[this->count] = pos;
+                    this->domains[this->count] = full & ~(masks[cellY] | masks[this->order + cellX]
+                        | masks[prunedBase + pos]);
+                    this->count++;
+                }
+
+                if (this->count == 0) {
+                    continue;
+                }
+
+                this->lines++;
+
+                if (!this->FilterLine()) {
+                    this->failures++;
+                    return false;
+                }
+
+                for(int c = 0; c < this->count; c++) {
+                    int pos = this->cells[c];
+                    int cellY = pos / this->order;
+                    int cellX = pos % this->order;
+                    uint32_t removed = full & ~(masks[cellY] | masks[this->order + cellX]
+                        | masks[prunedBase + pos] | this->domains[c]);
+
+                    if (removed) {
+                        trail.Or(prunedBase + pos, removed);
+                        this->pruned += __builtin_popcount(removed);
+
+                        // The crossing line has to be filtered again.
+                        pending |= ((uint64_t)1) << (isRow ? this->order + cellX : cellY);
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        void PrintStats(std::ostream &output) const {
+            output << "All-different: " << this->lines << " lines filtered, "
+                << this->failures << " Hall violations, " << this->pruned << " values pruned\n";
+        }
+};
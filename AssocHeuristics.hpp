@@ -21,7 +21,17 @@
 #include <bitset>
 #include <iomanip>
 #include <sstream>
+#include <vector>
+#include <random>
 #include <string.h>
+#include "SearchArena.hpp"
+#include "SearchTrail.hpp"
+#include "NogoodCache.hpp"
+#include "AllDifferent.hpp"
+#include "PropertySpec.hpp"
+#include "SearchProgress.hpp"
+#include "SearchBudget.hpp"
+#include "TableWriter.hpp"
 
 /**
  * @brief Find groups (Use the associative property in the heuristic search.)
@@ -31,45 +41,84 @@ class AssocHeuristics {
         int order;
         int size;
         uint8_t *cayley;         // Cayley table
-        uint32_t *track;         // Bitmaps of already used values.
+        SearchArena arena;       // The memory of the arrays. (Except the optional objects.)
+        SearchTrail trail;       // Assignment stack and undo log.
+        SearchTrail::Frame *frames;
         uint32_t *rowValues;     // Bitmaps of currently used values in rows.
         uint32_t *columnValues;  // Bitmaps of currently used values in columns.
+        uint32_t *pruned;        // Bitmaps of the values removed from the cells by propagation.
         int x;
         int y;
         int pos;
+        int depth;               // Index of the current frame.
+        int firstDepth;          // Backtracking never goes before this frame.
+        int lastDepth;           // The search reports a result when this frame is set.
+        int frameCount;          // Number of the cells visited by the search.
+        bool abelian;            // Only symmetric tables: the upper triangle is visited.
         bool found;
+        uint64_t nodes;          // Number of assignments made.
+
+        /*
+            Conflict-directed backjumping
+        */
+        bool backjumping;
+        int *depthOf;            // Frame index of each cell. -1 for the fixed cells.
+        uint8_t *rowWhere;       // [row * order + value - 1] = column of the value in the row.
+        uint8_t *columnWhere;    // [column * order + value - 1] = row of the value in the column.
+        int conflictWords;       // Size of a conflict set in 64 bit words.
+        uint64_t *conflicts;     // Per frame: the earlier frames causing its rejections.
+        uint8_t *solutionBelow;  // Per frame: a result was found since the frame was entered.
+        NogoodCache *nogoods;    // Learnt failures. (Optional)
+        AllDifferent *allDifferent; // Row and column filtering. (Optional)
+        bool elementOrders;      // Lagrange pruning on the power sequences.
+        PropertySpec spec;       // Required properties of the results.
+        bool hasSpec;
+        SearchProgress *progress; // Periodic reports. (Optional, not owned)
+        bool estimateDue;        // The progress asked for a new estimate.
+        uint8_t *domainSize;     // Per frame: number of the possible values when it was entered.
         
+        inline void LoadFrame() {
+            this->pos = this->frames[this->depth].pos;
+            this->x = this->frames[this->depth].x;
+            this->y = this->frames[this->depth].y;
+        }
+
         inline bool StepForward() {
-            if (this->x >= this->order - 1) {
-                if (this->y >= this->order - 1) {
-                    return false;
-                }
-                
-                this->x = 1;
-                this->y++;
-                this->pos += 2;
-            } else {
-                this->x++;
-                this->pos++;
+            if (this->depth >= this->lastDepth) {
+                return false;
+            }
+
+            this->depth++;
+            this->trail.Enter(this->depth);
+            this->LoadFrame();
+
+            if (this->backjumping) {
+                memset(this->conflicts + this->depth * this->conflictWords, 0,
+                    this->conflictWords * sizeof(uint64_t));
+                this->solutionBelow[this->depth] = 0;
+            }
+
+            if (this->progress != nullptr) {
+                this->RecordDomainSize();
             }
 
             return true;
         }
 
+        inline void RecordDomainSize() {
+            uint32_t full = (((uint64_t)1) << this->order) - 1;
+            this->domainSize[this->depth] = __builtin_popcount(full
+                & ~(this->rowValues[this->y] | this->columnValues[this->x] | this->pruned[this->pos]));
+        }
+
         inline bool StepBackward() {
-            if (this->x <= 1) {
-                if (this->y <= 1) {
-                    return false;
-                }
-                
-                this->x = this->order - 1;
-                this->y--;
-                this->pos -= 2;
-            } else {
-                this->x--;
-                this->pos--;
+            if (this->depth <= this->firstDepth) {
+                return false;
             }
 
+            this->depth--;
+            this->LoadFrame();
+
             return true;
         }
 
@@ -78,62 +127,470 @@ class AssocHeuristics {
             uint32_t bit = ((uint32_t)1) << normalValue;
 
             this->cayley[this->pos] = value;
-            this->track[this->pos] |= bit;
-            this->rowValues[this->y] |= bit;
-            this->columnValues[this->x] |= bit;
+            this->frames[this->depth].tried |= bit;
+            this->trail.Or(this->y, bit);
+            this->trail.Or(this->order + this->x, bit);
+            this->rowWhere[this->y * this->order + normalValue] = this->x;
+            this->columnWhere[this->x * this->order + normalValue] = this->y;
+            this->nodes++;
+
+            if (this->progress != nullptr && (this->nodes & 0xFFFF) == 0) {
+                this->progress->Report(this->nodes, this->GetProgress());
+                this->estimateDue = this->progress->IsEstimateDue();
+            }
+
+            if (this->abelian && this->x != this->y) {
+                /*
+                    Mirror cell
+                */
+                this->cayley[this->x * this->order + this->y] = value;
+                this->trail.Or(this->x, bit);
+                this->trail.Or(this->order + this->y, bit);
+                this->rowWhere[this->x * this->order + normalValue] = this->y;
+                this->columnWhere[this->y * this->order + normalValue] = this->x;
+            }
 
             /*std::cout << "Columns[4]: " << std::bitset<32>(this->columnValues[4]) << '\n';
             std::cout << "Rows[1]: " << std::bitset<32>(this->rowValues[1]) << '\n';
-            std::cout << "Track[9]: " << std::bitset<32>(this->track[9]) << '\n';
+            std::cout << "Tried: " << std::bitset<32>(this->frames[this->depth].tried) << '\n';
             */
             
             // std::cout << this->GetAsText(true) << '\n';
         }
 
-        inline void Unset(bool isBackTracking) {
-            if (isBackTracking) {
-                this->track[this->pos] = 0;
-            }
+        /**
+         * @brief Clears the cell of the current frame and undoes
+         * the changes of its assignment. The tried values are kept.
+         */
+        inline void Unset() {
+            this->cayley[this->pos] = 0;
 
-            uint8_t value = this->cayley[this->pos];
-            if (value == 0) {
-                // Nothing to unset
-                // std::cout << this->GetAsText(true) << '\n';
-                return;
+            if (this->abelian) {
+                this->cayley[this->x * this->order + this->y] = 0;
             }
 
-            uint8_t normalValue = value - 1;
-            uint32_t bit = ~(((uint32_t)1) << normalValue);
-
-            this->cayley[this->pos] = 0;
-            this->rowValues[this->y] &= bit;
-            this->columnValues[this->x] &= bit;
+            this->trail.Undo(this->frames[this->depth].mark);
 
             // std::cout << this->GetAsText(true) << '\n';
         }
 
+        /**
+         * @brief Clears the cells of the frames "from" -> "to". (Without
+         * undoing the bitmaps.)
+         */
+        void ClearCells(int from, int to) {
+            for(int d = from; d <= to; d++) {
+                this->cayley[this->frames[d].pos] = 0;
+
+                if (this->abelian) {
+                    this->cayley[this->frames[d].x * this->order + this->frames[d].y] = 0;
+                }
+            }
+        }
+
+        /**
+         * @brief Forgets the learnt nogoods, when the options they were
+         * learnt under change.
+         */
+        void ClearNogoods() {
+            if (this->nogoods != nullptr) {
+                this->nogoods->Clear();
+            }
+        }
+
         inline uint8_t Mult(uint8_t a, uint8_t b) {
             return this->cayley[a * this->order + b];
         }
 
+        void Clear() {
+            memset(this->cayley, 0, this->size * sizeof(uint8_t));
+            this->trail.Reset();
+            this->depth = 0;
+            this->firstDepth = 0;
+            this->lastDepth = this->frameCount - 1;
+            this->found = false;
+            this->nodes = 0;
+            this->LoadFrame();
+            memset(this->conflicts, 0, this->trail.GetFrameCount() * this->conflictWords * sizeof(uint64_t));
+            memset(this->solutionBelow, 0, this->trail.GetFrameCount());
+            memset(this->rowWhere, 0, this->size * sizeof(uint8_t));
+            memset(this->columnWhere, 0, this->size * sizeof(uint8_t));
+
+            /*
+                Fixed values
+            */
+            for(int i = 0; i < this->order; i++) {
+                /*
+                    Horizontal
+                */
+                *(this->cayley + i) = i + 1;
+                this->columnValues[i] |= 1 << i;
+                this->columnWhere[i * this->order + i] = 0;
+
+                /*
+                    Vertical
+                */
+                *(this->cayley + i * this->order) = i + 1;
+                this->rowValues[i] |= 1 << i;
+                this->rowWhere[i * this->order + i] = 0;
+            }
+
+            this->arena.SaveSnapshot();
+        }
+
+        /**
+         * @brief Records that the cell at "cellPos" took part in
+         * the rejection of a value in the current frame.
+         */
+        inline void AddConflict(int cellPos) {
+            int culprit = this->depthOf[cellPos];
+
+            if (culprit >= 0 && culprit < this->depth) {
+                this->conflicts[this->depth * this->conflictWords + (culprit >> 6)]
+                    |= ((uint64_t)1) << (culprit & 63);
+            }
+        }
+
+        /**
+         * @brief The values excluded by the row and column bitmaps
+         * are only checked when the frame runs out of values. For each
+         * one, the earlier of the two cells holding it is the reason.
+         */
+        void AddLatinConflicts() {
+            uint32_t row = this->rowValues[this->y];
+            uint32_t column = this->columnValues[this->x];
+            uint32_t used = row | column;
+
+            if (this->pruned[this->pos] & ~used) {
+                this->AddAllConflicts();
+            }
+
+            while(used) {
+                int normalValue = __builtin_ctz(used);
+                uint32_t bit = ((uint32_t)1) << normalValue;
+                int rowCell = -1;
+                int columnCell = -1;
+                used &= ~bit;
+
+                if (row & bit) {
+                    rowCell = this->y * this->order + this->rowWhere[this->y * this->order + normalValue];
+                }
+
+                if (column & bit) {
+                    columnCell = this->columnWhere[this->x * this->order + normalValue] * this->order + this->x;
+                }
+
+                if (rowCell < 0 || (columnCell >= 0 && this->depthOf[columnCell] < this->depthOf[rowCell])) {
+                    this->AddConflict(columnCell);
+                } else {
+                    this->AddConflict(rowCell);
+                }
+            }
+        }
+
+        /**
+         * @brief Blames all earlier frames. Used when the reason
+         * of a rejection is not tracked. (Propagation)
+         */
+        void AddAllConflicts() {
+            uint64_t *set = this->conflicts + this->depth * this->conflictWords;
+
+            for(int w = 0; w < (this->depth >> 6); w++) {
+                set[w] = ~(uint64_t)0;
+            }
+
+            set[this->depth >> 6] |= (((uint64_t)1) << (this->depth & 63)) - 1;
+        }
+
+        /**
+         * @brief After a result, every frame has to be retried in
+         * chronological order, since the values of the frames are
+         * not in conflict any more.
+         */
+        void MarkSolution() {
+            for(int d = 0; d <= this->depth; d++) {
+                uint64_t *set = this->conflicts + d * this->conflictWords;
+                memset(set, 0, this->conflictWords * sizeof(uint64_t));
+
+                for(int w = 0; w < (d >> 6); w++) {
+                    set[w] = ~(uint64_t)0;
+                }
+
+                set[d >> 6] = (((uint64_t)1) << (d & 63)) - 1;
+                this->solutionBelow[d] = 1;
+            }
+        }
+
+        /**
+         * @brief Stores the assignments of the conflict set of an
+         * exhausted frame as a nogood. Together they can't be
+         * extended to a group, whatever the other cells contain.
+         *
+         * @param target The latest frame in the set. (Watched literal.)
+         */
+        void LearnNogood(const uint64_t *set, int target) {
+            uint16_t literals[NogoodCache::MaxLength];
+            int length = 0;
+
+            for(int w = 0; w < this->conflictWords; w++) {
+                uint64_t bits = set[w];
+
+                while(bits) {
+                    int d = w * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+
+                    if (d == target) {
+                        continue;
+                    }
+
+                    if (length >= NogoodCache::MaxLength - 1) {
+                        // Too long to be useful
+                        this->nogoods->CountTooLong();
+                        return;
+                    }
+
+                    int cellPos = this->frames[d].pos;
+                    literals[length++] = NogoodCache::Literal(cellPos, this->cayley[cellPos]);
+                }
+            }
+
+            int targetPos = this->frames[target].pos;
+            this->nogoods->Insert(NogoodCache::Literal(targetPos, this->cayley[targetPos]), literals, length);
+        }
+
+        /**
+         * @brief The next power of "element": g^(k+1) = g^k * g = g * g^k,
+         * so it can be in column g or in row g.
+         *
+         * @param cell Output: position of the cell used.
+         * @return The 1-based power or 0 if unknown.
+         */
+        inline uint8_t NextPower(int element, int power, int &cell) {
+            cell = power * this->order + element;
+
+            if (this->cayley[cell] == 0) {
+                cell = element * this->order + power;
+            }
+
+            return this->cayley[cell];
+        }
+
+        /**
+         * @brief Follows the power sequence g, g^2, g^3, ... over the
+         * known entries. When it reaches the identity, its length is
+         * the order of g, which has to divide the group order (Lagrange).
+         * The sequence can't be longer than the group order either.
+         *
+         * @return False if the current partial table breaks this.
+         */
+        inline bool CheckElementOrder(int element) {
+            int power = element;
+            int length = 1;
+            int cell;
+
+            while(true) {
+                uint8_t next = this->NextPower(element, power, cell);
+
+                if (next == 0) {
+                    return true;    // No information
+                }
+
+                power = next - 1;
+                length++;
+
+                if (power == 0) {
+                    if (this->order % length == 0 && (this->spec.exponent == 0 || this->spec.exponent % length == 0)) {
+                        return true;
+                    }
+
+                    break;
+                }
+
+                if (length >= this->order || (this->spec.exponent > 0 && length >= this->spec.exponent)) {
+                    break;
+                }
+            }
+
+            if (this->backjumping) {
+                power = element;
+
+                for(int i = 1; i < length; i++) {
+                    power = this->NextPower(element, power, cell) - 1;
+                    this->AddConflict(cell);
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief The free cells in raster order. In abelian mode
+         * only the upper triangle (y <= x), the lower one is mirrored.
+         */
+        void SetVisitOrder() {
+            int d = 0;
+
+            for(int i = 0; i < this->size; i++) {
+                this->depthOf[i] = -1;
+            }
+
+            for(int y = 1; y < this->order; y++) {
+                for(int x = this->abelian ? y : 1; x < this->order; x++) {
+                    this->trail.SetFrameCell(d, y * this->order + x, x, y);
+                    this->depthOf[y * this->order + x] = d;
+
+                    if (this->abelian) {
+                        this->depthOf[x * this->order + y] = d;
+                    }
+                    d++;
+                }
+            }
+
+            this->frameCount = d;
+        }
+
+        /**
+         * @brief Checks the bounds of the property spec which can be
+         * decided on the partial table. The candidate value is already
+         * in the table, but not in the bitmaps.
+         *
+         * @return False if no completion can have the properties.
+         */
+        bool CheckProperties() {
+            int value = this->cayley[this->pos];
+
+            if (this->spec.HasInvolutionBounds()) {
+                /*
+                    g is an involution if g * g = e. It is still possible
+                    if the identity is not in its row or column elsewhere.
+                */
+                int known = 0;
+                int possible = 0;
+
+                for(int g = 1; g < this->order; g++) {
+                    uint8_t square = this->cayley[g * this->order + g];
+
+                    if (square == 1) {
+                        known++;
+                    }
+                    else if (square == 0 && !((this->rowValues[g] | this->columnValues[g]) & 1)
+                        && !(value == 1 && (g == this->x || g == this->y))) {
+
+                        possible++;
+                    }
+                }
+
+                if ((this->spec.maxInvolutions >= 0 && known > this->spec.maxInvolutions)
+                    || known + possible < this->spec.minInvolutions) {
+                    
+                    return false;
+                }
+            }
+
+            if (this->spec.HasCenterBounds()) {
+                /*
+                    g is surely in the center if it commutes with every element,
+                    and possibly if there is no known pair to the contrary.
+                */
+                int sure = 0;
+                int possible = 0;
+
+                for(int g = 0; g < this->order; g++) {
+                    bool complete = true;
+                    bool commutes = true;
+
+                    for(int h = 1; h < this->order; h++) {
+                        uint8_t gh = this->cayley[g * this->order + h];
+                        uint8_t hg = this->cayley[h * this->order + g];
+
+                        if (gh == 0 || hg == 0) {
+                            complete = false;
+                        }
+                        else if (gh != hg) {
+                            commutes = false;
+                            break;
+                        }
+                    }
+
+                    if (commutes) {
+                        possible++;
+
+                        if (complete) {
+                            sure++;
+                        }
+                    }
+                }
+
+                if (possible < this->spec.minCenter || (this->spec.maxCenter >= 0 && sure > this->spec.maxCenter)) {
+                    return false;
+                }
+            }
+
+            if (this->spec.nonAbelian) {
+                /*
+                    Fails when all pairs are known to commute.
+                */
+                for(int g = 1; g < this->order; g++) {
+                    for(int h = 1; h < g; h++) {
+                        uint8_t gh = this->cayley[g * this->order + h];
+
+                        if (gh == 0 || gh != this->cayley[h * this->order + g]) {
+                            return true;
+                        }
+                    }
+                }
+
+                return false;
+            }
+
+            return true;
+        }
+
         inline int FindPossibleValue() {
             uint8_t oldValue = this->cayley[this->pos];
+            int mirror = this->abelian ? this->x * this->order + this->y : this->pos;
+            uint32_t &tried = this->frames[this->depth].tried;
+            uint32_t used = this->rowValues[this->y] | this->columnValues[this->x] | this->pruned[this->pos];
 
             start_find:
             
-            uint32_t bitMap = ~(this->track[this->pos] | this->rowValues[this->y] | this->columnValues[this->x]);
+            uint32_t bitMap = ~(tried | used);
             // https://gcc.gnu.org/onlinedocs/gcc-4.8.0/gcc/Other-Builtins.html
             int value = __builtin_ffs(bitMap);
 
             if (value > this->order) {
                 this->cayley[this->pos] = oldValue;
+                this->cayley[mirror] = oldValue;
                 return value;
             }
 
             this->cayley[this->pos] = value;
+            this->cayley[mirror] = value;
             int normalValue = value - 1;
             uint8_t left, x_i, right, i_y;
 
+            if (this->nogoods != nullptr) {
+                int length;
+                const uint16_t *literals = this->nogoods->Find(this->pos, value, this->cayley, length);
+
+                if (literals != nullptr) {
+                    tried |= ((uint32_t)1) << normalValue;
+
+                    for(int i = 0; i < length; i++) {
+                        this->AddConflict(NogoodCache::LiteralPos(literals[i]));
+                    }
+
+                    goto start_find;
+                }
+            }
+
+            if (this->elementOrders && (!this->CheckElementOrder(this->x)
+                || (this->y != this->x && !this->CheckElementOrder(this->y)))) {
+                
+                tried |= ((uint32_t)1) << normalValue;
+                goto start_find;
+            }
+
             for(uint8_t i = 0; i < this->order; i++) {
                 /*
                     Right associative checks (y*x)*i = y*(x*i)
@@ -154,15 +611,27 @@ class AssocHeuristics {
                 }
 
                 if (left != right) {
-                    this->track[this->pos] |= ((uint32_t)1) << normalValue;
+                    tried |= ((uint32_t)1) << normalValue;
+
+                    if (this->backjumping) {
+                        this->AddConflict(normalValue * this->order + i);
+                        this->AddConflict(this->x * this->order + i);
+                        this->AddConflict(this->y * this->order + x_i - 1);
+                    }
+
                     goto start_find;
                 }
 
                 /*
                     Left associative checks i*(y*x) = (i*y)*x
+                    In an abelian table they are the same on the diagonal.
                 */
                 left_checks:
 
+                if (this->abelian && this->x == this->y) {
+                    continue;
+                }
+
                 left = this->Mult(i, normalValue);
                 if (left == 0) {
                     continue;   // No information
@@ -179,12 +648,30 @@ class AssocHeuristics {
                 }
 
                 if (left != right) {
-                    this->track[this->pos] |= ((uint32_t)1) << normalValue;
+                    tried |= ((uint32_t)1) << normalValue;
+
+                    if (this->backjumping) {
+                        this->AddConflict(i * this->order + normalValue);
+                        this->AddConflict(i * this->order + this->y);
+                        this->AddConflict((i_y - 1) * this->order + this->x);
+                    }
+
                     goto start_find;
                 }
             }
 
+            if (this->hasSpec && !this->CheckProperties()) {
+                tried |= ((uint32_t)1) << normalValue;
+
+                if (this->backjumping) {
+                    this->AddAllConflicts();
+                }
+
+                goto start_find;
+            }
+
             this->cayley[this->pos] = oldValue;
+            this->cayley[mirror] = oldValue;
 
             return value;
         }
@@ -195,123 +682,623 @@ class AssocHeuristics {
             while(this->StepBackward()) {
                 next = this->FindPossibleValue();
                 if (next <= this->order) {
-                    this->Unset(false);
+                    this->Unset();
                     return next;
                 }
 
-                this->Unset(true);
+                this->Unset();
             }
 
             return this->order + 1;
         }
 
+        /**
+         * @brief Instead of stepping back one cell at a time, jumps
+         * straight to the latest frame in the conflict set of the
+         * exhausted frame. (Prosser's conflict-directed backjumping.)
+         * The frames in between are not responsible for the failure,
+         * so their other values can't lead to a result either.
+         */
+        inline uint32_t BackJumping() {
+            int next;
+
+            while(true) {
+                this->AddLatinConflicts();
+
+                /*
+                    Find the latest culprit
+                */
+                uint64_t *set = this->conflicts + this->depth * this->conflictWords;
+                int target = -1;
+
+                for(int w = this->conflictWords - 1; w >= 0; w--) {
+                    if (set[w]) {
+                        target = w * 64 + 63 - __builtin_clzll(set[w]);
+                        break;
+                    }
+                }
+
+                if (this->nogoods != nullptr && !this->solutionBelow[this->depth] && target >= 0) {
+                    this->LearnNogood(set, target);
+                }
+
+                if (target < this->firstDepth) {
+                    return this->order + 1;
+                }
+
+                /*
+                    The reasons of the failure are inherited by the target.
+                */
+                uint64_t *targetSet = this->conflicts + target * this->conflictWords;
+
+                for(int w = 0; w < this->conflictWords; w++) {
+                    targetSet[w] |= set[w];
+                }
+
+                targetSet[target >> 6] &= ~(((uint64_t)1) << (target & 63));
+
+                /*
+                    Undo the frames after the target.
+                */
+                for(int d = target + 1; d < this->depth; d++) {
+                    this->cayley[this->frames[d].pos] = 0;
+
+                    if (this->abelian) {
+                        this->cayley[this->frames[d].x * this->order + this->frames[d].y] = 0;
+                    }
+                }
+
+                this->trail.Undo(this->frames[target + 1].mark);
+                this->depth = target;
+                this->LoadFrame();
+
+                next = this->FindPossibleValue();
+                if (next <= this->order) {
+                    this->Unset();
+                    return next;
+                }
+
+                this->Unset();
+            }
+        }
+
     public:
-        AssocHeuristics(uint8_t order) {
+        /**
+         * @brief Size of the arena of an engine. The arrays restored by
+         * Reset() are taken right after the undo log of the trail, and
+         * are followed by the others and the snapshot.
+         */
+        static size_t ArenaBytes(int order) {
             if (order < 2 || order > 31) {
                 throw std::runtime_error("Invalid order value. Allowed: 2 -> 31");
             }
 
+            int size = order * order;
+            int frameCount = (order - 1) * (order - 1);
+            int maskCount = 2 * order + size;
+            size_t state = SearchTrail::StateBytes(maskCount, frameCount)
+                + SearchArena::Bytes<uint8_t>(size)
+                + SearchArena::Bytes<uint64_t>(frameCount * ((frameCount + 63) / 64))
+                + SearchArena::Bytes<uint8_t>(frameCount)
+                + 2 * SearchArena::Bytes<uint8_t>(size);
+
+            /*
+                Undo log + the state and its snapshot + the rest
+            */
+            return SearchTrail::ArenaBytes(maskCount, frameCount) - SearchTrail::StateBytes(maskCount, frameCount)
+                + 2 * state + SearchArena::Bytes<int>(size) + SearchArena::Bytes<uint8_t>(frameCount);
+        }
+
+        AssocHeuristics(uint8_t order)
+            : arena(AssocHeuristics::ArenaBytes(order)),
+              trail(2 * order + order * order, (order - 1) * (order - 1), arena) {
+
             this->order = order;
             this->size = order * order;
-            this->cayley = new uint8_t[this->size];
-            this->track = new uint32_t[this->size];
-            this->rowValues = new uint32_t[order];
-            this->columnValues = new uint32_t[order];
-            this->x = 1;
-            this->y = 1;
-            this->pos = this->order + 1;
-            this->found = false;
-
-            memset(this->cayley, 0, this->size * sizeof(uint8_t));
-            memset(this->track, 0, this->size * sizeof(uint32_t));
-            memset(this->rowValues, 0, order * sizeof(uint32_t));
-            memset(this->columnValues, 0, order * sizeof(uint32_t));
+            this->frames = this->trail.GetFrames();
+            this->rowValues = this->trail.GetMasks();
+            this->columnValues = this->rowValues + order;
+            this->pruned = this->rowValues + 2 * order;
+            this->backjumping = false;
+            this->conflictWords = (this->trail.GetFrameCount() + 63) / 64;
 
             /*
-                Fixed values
+                The arrays of the snapshot, then the rest.
             */
-            for(int i = 0; i < this->order; i++) {
+            this->cayley = this->arena.Take<uint8_t>(this->size);
+            this->conflicts = this->arena.Take<uint64_t>(this->trail.GetFrameCount() * this->conflictWords);
+            this->solutionBelow = this->arena.Take<uint8_t>(this->trail.GetFrameCount());
+            this->rowWhere = this->arena.Take<uint8_t>(this->size);
+            this->columnWhere = this->arena.Take<uint8_t>(this->size);
+            this->arena.MarkSnapshot(this->rowValues);
+            this->depthOf = this->arena.Take<int>(this->size);
+            this->domainSize = this->arena.Take<uint8_t>(this->trail.GetFrameCount());
+
+            this->nogoods = nullptr;
+            this->allDifferent = nullptr;
+            this->elementOrders = false;
+            this->abelian = false;
+            this->hasSpec = false;
+            this->progress = nullptr;
+            this->estimateDue = false;
+
+            this->SetVisitOrder();
+            this->Clear();
+        }
+
+        ~AssocHeuristics() {
+            delete this->nogoods;
+            delete this->allDifferent;
+        }
+
+        /**
+         * @brief Returns to the initial state with one copy of the arrays
+         * from their snapshot. (Saved by the constructor and SetAbelian().)
+         * The options are kept, except the depth limit.
+         */
+        void Reset() {
+            this->arena.RestoreSnapshot();
+            this->trail.ClearLog();
+            this->depth = 0;
+            this->firstDepth = 0;
+            this->lastDepth = this->frameCount - 1;
+            this->found = false;
+            this->nodes = 0;
+            this->LoadFrame();
+        }
+
+        /**
+         * @brief Enables conflict-directed backjumping. The results
+         * are the same, but dead subtrees are skipped. Call it before
+         * the first Next().
+         */
+        void SetBackjumping(bool enabled) {
+            this->backjumping = enabled;
+        }
+
+        /**
+         * @brief Enables nogood learning (and backjumping, which
+         * provides the nogoods). The failures of the conflict sets
+         * are stored in a cache of the given size, and candidates
+         * completing a stored nogood are rejected immediately.
+         * Call it before the first Next(). Capacity 0 disables it.
+         */
+        void SetNogoodLearning(int capacity) {
+            delete this->nogoods;
+            this->nogoods = nullptr;
+
+            if (capacity > 0) {
+                this->nogoods = new NogoodCache(capacity, this->order);
+                this->backjumping = true;
+            }
+        }
+
+        /**
+         * @brief Enables the all-different filtering of the rows and
+         * columns after each assignment. Values which can't be part of
+         * any completion of a row or column are removed from the cells,
+         * and assignments leaving a row or column incompletable are
+         * rejected. Call it before the first Next().
+         */
+        void SetAllDifferent(bool enabled) {
+            delete this->allDifferent;
+            this->allDifferent = enabled ? new AllDifferent(this->order) : nullptr;
+        }
+
+        /**
+         * @brief Enables the element order pruning: a candidate value
+         * is rejected if it closes the power sequence of its column
+         * element with a length not dividing the group order.
+         * Call it before the first Next().
+         */
+        void SetElementOrderPruning(bool enabled) {
+            this->elementOrders = enabled;
+        }
+
+        /**
+         * @brief Enables the abelian mode: only commutative tables are
+         * searched. Each cell of the upper triangle is assigned together
+         * with its mirror, and the left associativity checks are skipped
+         * on the diagonal, where they are the same as the right ones.
+         * The learnt nogoods rely on the mode, so they are dropped.
+         * Call it before the first Next(), LoadPrefix() or SetDepthLimit().
+         */
+        void SetAbelian(bool enabled) {
+            this->abelian = enabled;
+            this->SetVisitOrder();
+            this->Clear();
+            this->ClearNogoods();
+        }
+
+        /**
+         * @brief Only search for groups with the given properties.
+         * The partial tables which can't have them are cut off.
+         * An exponent limit also enables the element order pruning.
+         * The learnt nogoods are only valid for one spec, so they are
+         * dropped. Call it before the first Next().
+         */
+        void SetPropertySpec(const PropertySpec &spec) {
+            if (spec.nonAbelian && this->abelian) {
+                throw std::runtime_error("A non-abelian spec can't be used in abelian mode.");
+            }
+
+            this->spec = spec;
+            this->hasSpec = !spec.IsEmpty();
+            this->ClearNogoods();
+
+            if (spec.exponent > 0) {
+                this->elementOrders = true;
+            }
+        }
+
+        /**
+         * @brief Reports the progress periodically during Next().
+         * Call it before the first Next(), after LoadPrefix().
+         * (nullptr: disabled)
+         */
+        void SetProgress(SearchProgress *progress) {
+            this->progress = progress;
+            this->estimateDue = false;
+
+            if (progress != nullptr) {
+                this->RecordDomainSize();
+            }
+        }
+
+        /**
+         * @brief Completed fraction of the search tree (0 -> 1), assuming
+         * that the subtrees of the values of a frame are of the same size.
+         * Only valid if progress reporting is enabled.
+         */
+        double GetProgress() {
+            double done = 0;
+            double weight = 1;
+
+            for(int d = this->firstDepth; d <= this->depth; d++) {
+                int size = this->domainSize[d];
+                int tried = __builtin_popcount(this->frames[d].tried);
+
+                if (size == 0 || tried == 0) {
+                    break;
+                }
+
+                // The current value is not completed yet.
+                done += weight * (tried - 1) / size;
+                weight /= size;
+            }
+
+            return done;
+        }
+
+        /**
+         * @brief Estimates the number of nodes still to be visited by
+         * random probing (Knuth's estimator). Each probe goes down a random
+         * path, and multiplies the number of possible values along the
+         * way. The average over the probes is an unbiased estimate.
+         *
+         * From the current node, the rest of the search consists of the
+         * subtrees of the values not tried yet on each frame of the path,
+         * so the probes are run from each frame (returned to the state
+         * when it was entered), and the estimates are summed. At the start
+         * of the search this is the size of the whole tree. Can be called
+         * between two Next() calls, or by the search itself (see
+         * SearchProgress::SetReestimation()). The state is restored.
+         *
+         * @param probes Number of probes per frame of the path.
+         */
+        double EstimateTreeSize(int probes, uint32_t seed) {
+            if (probes < 1) {
+                throw std::runtime_error("EstimateTreeSize: at least 1 probe is needed.");
+            }
+
+            std::mt19937 random(seed);
+            std::vector<uint8_t> state(this->arena.GetSnapshotSize());
+            int top = this->depth;
+            uint64_t savedNodes = this->nodes;
+            SearchProgress *savedProgress = this->progress;
+            uint8_t candidates[32];
+            double sum = 0;
+
+            this->arena.CopySnapshotArrays(&state[0]);
+            this->trail.SaveLog();
+            this->progress = nullptr;
+
+            for(int start = top; start >= this->firstDepth; start--) {
+                uint32_t tried = this->frames[start].tried;
+                double levelSum = 0;
+
                 /*
-                    Horizontal
+                    Back to the frame: the cells from it on are cleared.
                 */
-                *(this->cayley + i) = i + 1;
-                this->columnValues[i] |= 1 << i;
+                this->ClearCells(start, top);
+                this->trail.Undo(this->frames[start].mark);
+                this->depth = start;
+                this->LoadFrame();
+
+                for(int p = 0; p < probes; p++) {
+                    double weight = 1;
+
+                    while(true) {
+                        int count = 0;
+                        int value;
+
+                        while((value = this->FindPossibleValue()) <= this->order) {
+                            candidates[count++] = value;
+                            this->frames[this->depth].tried |= ((uint32_t)1) << (value - 1);
+                        }
+
+                        if (count == 0) {
+                            break;
+                        }
+
+                        weight *= count;
+                        levelSum += weight;
+                        this->Set(candidates[random() % count]);
+
+                        if (this->allDifferent != nullptr
+                            && !this->allDifferent->Propagate(this->trail, this->cayley, 2 * this->order, this->x, this->y)) {
+                            
+                            break;
+                        }
+
+                        if (!this->StepForward()) {
+                            break;
+                        }
+                    }
+
+                    /*
+                        Back to the frame, with its values tried before the call.
+                    */
+                    this->ClearCells(start, this->depth);
+                    this->trail.Undo(this->frames[start].mark);
+                    this->depth = start;
+                    this->LoadFrame();
+                    this->frames[start].tried = tried;
+                }
+
+                sum += levelSum / probes;
 
                 /*
-                    Vertical
+                    The state of the call, for the next frame up.
                 */
-                *(this->cayley + i * this->order) = i + 1;
-                this->rowValues[i] |= 1 << i;
+                this->arena.LoadSnapshotArrays(&state[0]);
+                this->trail.RestoreLog();
             }
+
+            this->depth = top;
+            this->LoadFrame();
+            this->nodes = savedNodes;
+            this->progress = savedProgress;
+
+            return sum;
         }
 
-        ~AssocHeuristics() {
-            delete[] this->cayley;
-            delete[] this->track;
-            delete[] this->rowValues;
-            delete[] this->columnValues;
+        /**
+         * @brief Returns the all-different filter or nullptr if disabled.
+         */
+        AllDifferent* GetAllDifferent() {
+            return this->allDifferent;
         }
 
-        bool Next() {
+        /**
+         * @brief Returns the nogood cache or nullptr if disabled.
+         */
+        NogoodCache* GetNogoodCache() {
+            return this->nogoods;
+        }
+
+        /**
+         * @brief Number of assignments made so far.
+         */
+        uint64_t GetNodeCount() {
+            return this->nodes;
+        }
+
+        /**
+         * @brief Returns the number of cells which are not fixed
+         * by the identity row and column. (In abelian mode only
+         * the upper triangle.)
+         */
+        int GetFreeCellCount() {
+            return this->frameCount;
+        }
+
+        /**
+         * @brief Stop the search after the first "depth" free cells
+         * (in raster order) are set. Each result of Next() is then
+         * a partial table, which can be used as a prefix for LoadPrefix().
+         */
+        void SetDepthLimit(int depth) {
+            if (depth < 1 || depth > this->GetFreeCellCount()) {
+                throw std::runtime_error("Invalid depth limit. Allowed: 1 -> "
+                    + std::to_string(this->GetFreeCellCount()));
+            }
+
+            this->lastDepth = depth - 1;
+        }
+
+        /**
+         * @brief Restart the search from a partial table, produced by
+         * a depth limited search. The first "depth" free cells are
+         * taken from the input and are never changed, so the search
+         * only enumerates the subtree below this prefix.
+         */
+        void LoadPrefix(const uint8_t *prefix, int depth) {
+            if (depth < 0 || depth >= this->GetFreeCellCount()) {
+                throw std::runtime_error("Invalid prefix depth. Allowed: 0 -> "
+                    + std::to_string(this->GetFreeCellCount() - 1));
+            }
+
+            this->Reset();
+
+            for(int d = 0; d < depth; d++) {
+                this->depth = d;
+                this->trail.Enter(d);
+                this->LoadFrame();
+
+                int value = prefix[this->pos];
+                uint32_t bit = ((uint32_t)1) << (value - 1);
+
+                if (value < 1 || value > this->order
+                    || (this->rowValues[this->y] & bit) || (this->columnValues[this->x] & bit)) {
+                    
+                    throw std::runtime_error("Invalid prefix: bad value at row " + std::to_string(this->y + 1)
+                        + ", column " + std::to_string(this->x + 1) + ".");
+                }
+
+                this->Set(value);
+            }
+
+            this->depth = depth;
+            this->firstDepth = depth;
+            this->trail.Enter(depth);
+            this->LoadFrame();
+        }
+
+    private:
+        /**
+         * @brief The search loop of Next(). With a budget, it can stop at
+         * the start of a node: the state is the same as before visiting it,
+         * so the next call continues from there.
+         *
+         * @param leaves Count mode: the results are counted here and the
+         * search continues, instead of returning at each one.
+         */
+        SearchStatus Search(SearchBudget *budget, uint64_t *leaves) {
             int next;
+            uint64_t visited = 0;
             this->found = false;
 
+            continue_search:
+
             do {
-                /*
-                    Search for a possible value
-                */
-                next = this->FindPossibleValue();
-                
-                if (next > this->order) {
+                while(true) {
+                    if (budget != nullptr && budget->IsExhausted(visited++)) {
+                        return SearchStatus::BudgetExhausted;
+                    }
+
+                    if (this->estimateDue) {
+                        /*
+                            Where the budget can stop the search, the
+                            state is the one EstimateTreeSize() expects.
+                        */
+                        this->estimateDue = false;
+                        this->progress->SetEstimate(this->nodes
+                            + this->EstimateTreeSize(this->progress->GetEstimateProbes(), (uint32_t)this->nodes));
+                    }
+
                     /*
-                        No value left to be tried => backtracking
+                        Search for a possible value
                     */
-                    this->Unset(true);
-                    next = this->BackTracking();
+                    next = this->FindPossibleValue();
+                    
                     if (next > this->order) {
-                        return false;
+                        /*
+                            No value left to be tried => backtracking
+                        */
+                        this->Unset();
+                        next = this->backjumping ? this->BackJumping() : this->BackTracking();
+                        if (next > this->order) {
+                            return SearchStatus::Finished;
+                        }
                     }
-                }
 
-                this->Unset(false);
-                this->Set(next);
+                    this->Unset();
+                    this->Set(next);
+
+                    if (this->allDifferent == nullptr
+                        || (this->allDifferent->Propagate(this->trail, this->cayley, 2 * this->order, this->x, this->y)
+                            && (!this->abelian || this->allDifferent->Propagate(this->trail, this->cayley,
+                                2 * this->order, this->y, this->x)))) {
+                        
+                        break;
+                    }
+
+                    /*
+                        A row or column can't be completed => try the next value
+                    */
+                    if (this->backjumping) {
+                        this->AddAllConflicts();
+                    }
+                }
 
                 // std::cin.get();
 
             } while(this->StepForward());
 
-            this->found = true;
+            if (this->backjumping) {
+                this->MarkSolution();
+            }
 
-            if (next > this->order) {
-                // Last one
-                return false;
+            if (leaves != nullptr) {
+                (*leaves)++;
+                goto continue_search;
             }
 
-            // More to be expected
-            return true;
+            this->found = true;
+
+            return SearchStatus::Found;
+        }
+
+    public:
+        /**
+         * @return True if a table was found. (Check Found() too.)
+         */
+        bool Next() {
+            return this->Search(nullptr, nullptr) == SearchStatus::Found;
+        }
+
+        /**
+         * @brief Next() within the limits of the budget. After
+         * BudgetExhausted, call it again to continue.
+         */
+        SearchStatus Next(SearchBudget &budget) {
+            return this->Search(&budget, nullptr);
+        }
+
+        /**
+         * @brief Counts the remaining results of the search (all of them
+         * after a LoadPrefix() or Reset()), without stopping at each one.
+         * Found() is false after it.
+         */
+        uint64_t Count() {
+            uint64_t leaves = 0;
+            this->Search(nullptr, &leaves);
+
+            return leaves;
         }
 
         std::string GetAsText(bool showTrack = false) {
-            std::stringstream result;
+            TableWriter writer;
+
+            if (!showTrack) {
+                writer.WriteTable(this->order, this->cayley);
+                return writer.ToString();
+            }
+
+            std::vector<uint32_t> track(this->size, 0);
+
+            for(int d = 0; d <= this->depth; d++) {
+                track[this->frames[d].pos] = this->frames[d].tried;
+            }
 
             for(int i = 0; i < this->order; i++) {
                 for(int j = 0; j < this->order; j++) {
-                    result << std::setfill('0') << std::setw(2)
-                        << (int)(*(this->cayley + j + i * this->order)) << ";";
+                    writer.AppendPadded(this->cayley[j + i * this->order]);
+                    writer.Append(';');
                 }
 
-                if (showTrack) {
-                    result << "    ";
+                writer.Append("    ", 4);
 
-                    for(int j = 0; j < this->order; j++) {
-                        result << std::bitset<8>(this->track[j + i * this->order]) << ";";
-                    }
+                for(int j = 0; j < this->order; j++) {
+                    writer.AppendBits(track[j + i * this->order], 8);
+                    writer.Append(';');
                 }
-                
-                result << '\n';
+
+                writer.Append('\n');
             }
 
-            return result.str();
+            return writer.ToString();
         }
 
         bool Found() {
@@ -0,0 +1,458 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * @brief Computes the automorphism group of a group given by its
+ * Cayley table: a generating set of Aut(G) and its order.
+ *
+ * An automorphism is determined by the images of a generating set of
+ * G. The generators are picked greedily (each one extends the generated
+ * subgroup the most), and the elements are listed in the order they are
+ * reached from the generators: each one is the product of an earlier
+ * element and a generator. The images of a candidate assignment are
+ * extended along this list, and the product rules
+ *      f(a * g) = f(a) * f(g)     (for each element a and generator g)
+ * are checked only for the pairs which the new generator added, so a
+ * candidate costs O(n * generators) at most.
+ *
+ * The image of a generator must have the same element order and
+ * conjugacy class size as the generator.
+ *
+ * Base and image search: for the generators g1, g2, ... (the base),
+ * the images of g_i which extend to an automorphism fixing g1 ... g_i-1
+ * form an orbit of the stabilizer. |Aut(G)| is the product of these
+ * orbit sizes. Only one automorphism is searched per orbit element, and
+ * the elements already in the orbit of the automorphisms found so far
+ * (or in the orbit of a failed candidate) are skipped. The automorphisms
+ * found are returned as the generators of Aut(G).
+ */
+class Automorphisms {
+    private:
+        int order;
+        const uint8_t *cayley;
+        std::vector<int> elementOrder;
+        std::vector<int> classSize;
+        std::vector<int> generators;
+        std::vector<int> sequence;          // Elements in the order of their images are computed.
+        std::vector<int> parent;            // element = parent * generators[parentGenerator]
+        std::vector<int> parentGenerator;
+        std::vector<int> levelStart;        // Range of the elements added by each generator in "sequence".
+        std::vector<int> levelEnd;
+        std::vector<int> image;
+        std::vector<uint8_t> used;
+        std::vector<std::vector<int>> found;     // Automorphisms found (0-based images)
+        std::vector<int> foundLevel;             // The first base point they don't fix.
+        std::vector<int> orbitSizes;
+        uint64_t groupOrder;
+        uint64_t candidates;
+
+        inline int Mult(int a, int b) const {
+            return this->cayley[a * this->order + b] - 1;
+        }
+
+        /**
+         * @brief Size of the subgroup generated by "current" and x.
+         */
+        int ClosureSize(const std::vector<int> &current, int x) const {
+            std::vector<uint8_t> member(this->order, 0);
+            std::vector<int> elements(1, 0);
+            std::vector<int> gens(current);
+            gens.push_back(x);
+            member[0] = 1;
+
+            for(size_t i = 0; i < elements.size(); i++) {
+                for(int g : gens) {
+                    int product = this->Mult(elements[i], g);
+
+                    if (!member[product]) {
+                        member[product] = 1;
+                        elements.push_back(product);
+                    }
+                }
+            }
+
+            return elements.size();
+        }
+
+        /**
+         * @brief Greedy generating set, and the element sequence with
+         * the parent of each element.
+         */
+        void PickGenerators() {
+            int n = this->order;
+            std::vector<int> position(n, -1);
+            int subgroupSize = 1;
+
+            this->sequence.assign(1, 0);
+            position[0] = 0;
+            this->parent.assign(n, -1);
+            this->parentGenerator.assign(n, -1);
+
+            while(subgroupSize < n) {
+                int best = -1;
+                int bestSize = 0;
+
+                for(int x = 1; x < n; x++) {
+                    if (position[x] >= 0) {
+                        continue;
+                    }
+
+                    int size = this->ClosureSize(this->generators, x);
+
+                    if (size > bestSize || (size == bestSize && this->elementOrder[x] > this->elementOrder[best])) {
+                        best = x;
+                        bestSize = size;
+                    }
+                }
+
+                int level = this->generators.size();
+                this->generators.push_back(best);
+                this->levelStart.push_back(this->sequence.size());
+
+                /*
+                    Close the sequence: the old elements only need the
+                    new generator, the new ones need all of them.
+                */
+                for(size_t i = 0; i < this->sequence.size(); i++) {
+                    for(int j = 0; j <= level; j++) {
+                        if ((int)i < this->levelStart[level] && j < level) {
+                            continue;
+                        }
+
+                        int product = this->Mult(this->sequence[i], this->generators[j]);
+
+                        if (position[product] < 0) {
+                            position[product] = this->sequence.size();
+                            this->sequence.push_back(product);
+                            this->parent[product] = this->sequence[i];
+                            this->parentGenerator[product] = j;
+                        }
+                    }
+                }
+
+                this->levelEnd.push_back(this->sequence.size());
+                subgroupSize = this->sequence.size();
+            }
+        }
+
+        void ComputeInvariants() {
+            int n = this->order;
+            std::vector<int> inverse(n);
+            this->elementOrder.assign(n, 1);
+            this->classSize.assign(n, 0);
+
+            for(int g = 0; g < n; g++) {
+                for(int h = 0; h < n; h++) {
+                    if (this->Mult(g, h) == 0) {
+                        inverse[g] = h;
+                        break;
+                    }
+                }
+
+                for(int e = g; e != 0; e = this->Mult(e, g)) {
+                    this->elementOrder[g]++;
+
+                    if (this->elementOrder[g] > n) {
+                        throw std::runtime_error("Automorphisms: the table is not a group.");
+                    }
+                }
+
+                if (g == 0) {
+                    this->elementOrder[g] = 1;
+                }
+            }
+
+            for(int g = 0; g < n; g++) {
+                std::vector<uint8_t> member(n, 0);
+
+                for(int x = 0; x < n; x++) {
+                    int conjugate = this->Mult(this->Mult(x, g), inverse[x]);
+
+                    if (!member[conjugate]) {
+                        member[conjugate] = 1;
+                        this->classSize[g]++;
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Maps the generator of the level to "candidate", and
+         * extends the images through the elements the generator added.
+         * @return False (with the changes undone) if it's not a bijective
+         * homomorphism on the generated subgroup.
+         */
+        bool Assign(int level, int candidate) {
+            int start = this->levelStart[level];
+            int end = this->levelEnd[level];
+            this->candidates++;
+
+            for(int i = start; i < end; i++) {
+                int element = this->sequence[i];
+                int value = candidate;
+
+                if (i > start) {
+                    value = this->Mult(this->image[this->parent[element]],
+                        this->image[this->generators[this->parentGenerator[element]]]);
+                }
+
+                if (this->used[value]) {
+                    this->Unassign(level, i);
+                    return false;
+                }
+
+                this->image[element] = value;
+                this->used[value] = 1;
+            }
+
+            /*
+                The product rules of the new pairs
+            */
+            for(int i = 0; i < end; i++) {
+                int a = this->sequence[i];
+
+                for(int j = (i < start ? level : 0); j <= level; j++) {
+                    int g = this->generators[j];
+
+                    if (this->image[this->Mult(a, g)] != this->Mult(this->image[a], this->image[g])) {
+                        this->Unassign(level, end);
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        void Unassign(int level, int end) {
+            for(int i = this->levelStart[level]; i < end; i++) {
+                int element = this->sequence[i];
+                this->used[this->image[element]] = 0;
+                this->image[element] = -1;
+            }
+        }
+
+        inline bool IsCandidate(int generator, int candidate) const {
+            return this->elementOrder[candidate] == this->elementOrder[generator]
+                && this->classSize[candidate] == this->classSize[generator];
+        }
+
+        /**
+         * @brief Searches for one automorphism extending the images of
+         * the generators below the level.
+         */
+        bool Extend(int level) {
+            if (level == (int)this->generators.size()) {
+                return true;
+            }
+
+            int generator = this->generators[level];
+
+            for(int candidate = 1; candidate < this->order; candidate++) {
+                if (this->used[candidate] || !this->IsCandidate(generator, candidate)) {
+                    continue;
+                }
+
+                if (this->Assign(level, candidate)) {
+                    if (this->Extend(level + 1)) {
+                        return true;
+                    }
+
+                    this->Unassign(level, this->levelEnd[level]);
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Marks the orbit of x under the automorphisms found at
+         * the level or below it (they all fix the base points before it).
+         */
+        void MarkOrbit(int level, int x, std::vector<uint8_t> &mark) const {
+            std::vector<int> queue(1, x);
+            mark[x] = 1;
+
+            for(size_t i = 0; i < queue.size(); i++) {
+                for(size_t k = 0; k < this->found.size(); k++) {
+                    if (this->foundLevel[k] < level) {
+                        continue;
+                    }
+
+                    int y = this->found[k][queue[i]];
+
+                    if (!mark[y]) {
+                        mark[y] = 1;
+                        queue.push_back(y);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief The search of the automorphisms. Called once, by the
+         * constructor.
+         */
+        void Compute() {
+            int n = this->order;
+            int levels = this->generators.size();
+
+            this->image.assign(n, -1);
+            this->used.assign(n, 0);
+            this->image[0] = 0;
+            this->used[0] = 1;
+
+            for(int level = 0; level < levels; level++) {
+                int generator = this->generators[level];
+                std::vector<uint8_t> inOrbit(n, 0);
+                std::vector<uint8_t> failed(n, 0);
+
+                this->MarkOrbit(level, generator, inOrbit);
+
+                for(int candidate = 1; candidate < n; candidate++) {
+                    if (inOrbit[candidate] || failed[candidate] || this->used[candidate]
+                        || !this->IsCandidate(generator, candidate)) {
+
+                        continue;
+                    }
+
+                    if (this->Assign(level, candidate) && this->Extend(level + 1)) {
+                        this->found.push_back(this->image);
+                        this->foundLevel.push_back(level);
+
+                        for(int k = levels - 1; k >= level; k--) {
+                            this->Unassign(k, this->levelEnd[k]);
+                        }
+
+                        std::fill(inOrbit.begin(), inOrbit.end(), 0);
+                        this->MarkOrbit(level, generator, inOrbit);
+                    } else {
+                        if (this->image[generator] >= 0) {
+                            this->Unassign(level, this->levelEnd[level]);
+                        }
+
+                        this->MarkOrbit(level, candidate, failed);
+                    }
+                }
+
+                int orbitSize = 0;
+
+                for(int x = 0; x < n; x++) {
+                    orbitSize += inOrbit[x];
+                }
+
+                this->orbitSizes.push_back(orbitSize);
+                this->groupOrder *= orbitSize;
+
+                /*
+                    Fix the base point for the next levels.
+                */
+                this->Assign(level, generator);
+            }
+        }
+
+    public:
+        /**
+         * @param cayley A group table, 1-based values (the format of the other modules).
+         */
+        Automorphisms(int order, const uint8_t *cayley) : order(order), cayley(cayley), groupOrder(1), candidates(0) {
+            if (order < 1 || order > 255) {
+                throw std::runtime_error("Invalid order value. Allowed: 1 -> 255");
+            }
+
+            this->ComputeInvariants();
+            this->PickGenerators();
+            this->Compute();
+        }
+
+        /**
+         * @brief |Aut(G)|
+         */
+        uint64_t GetOrder() const {
+            return this->groupOrder;
+        }
+
+        /**
+         * @brief The generating set of G used as the base. (1-based)
+         */
+        std::vector<uint8_t> GetBase() const {
+            std::vector<uint8_t> base;
+
+            for(int g : this->generators) {
+                base.push_back(g + 1);
+            }
+
+            return base;
+        }
+
+        /**
+         * @brief Generators of Aut(G): the image of each element. (1-based)
+         */
+        std::vector<std::vector<uint8_t>> GetGenerators() const {
+            std::vector<std::vector<uint8_t>> result;
+
+            for(const std::vector<int> &automorphism : this->found) {
+                std::vector<uint8_t> images;
+
+                for(int value : automorphism) {
+                    images.push_back(value + 1);
+                }
+
+                result.push_back(images);
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief The orbit sizes of the base points. Their product is |Aut(G)|.
+         */
+        const std::vector<int>& GetOrbitSizes() const {
+            return this->orbitSizes;
+        }
+
+        /**
+         * @brief Number of candidate images tried.
+         */
+        uint64_t GetCandidateCount() const {
+            return this->candidates;
+        }
+
+        /**
+         * @brief The generators as the images of the base points, like "2->3, 5->7".
+         */
+        std::string PrintGenerators() const {
+            std::stringstream o;
+
+            for(const std::vector<int> &automorphism : this->found) {
+                for(size_t i = 0; i < this->generators.size(); i++) {
+                    int g = this->generators[i];
+                    o << (i > 0 ? ", " : "") << (g + 1) << "->" << (automorphism[g] + 1);
+                }
+
+                o << '\n';
+            }
+
+            return o.str();
+        }
+};
@@ -0,0 +1,399 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Classifier.hpp"
+#include "CycleGraph.hpp"
+#include "Sharding.hpp"
+#include "TableWriter.hpp"
+
+/**
+ * @brief The properties of one table, computed by BatchAnalyzer.
+ */
+struct TableProperties {
+    enum Flag : uint8_t {
+        Associative = 1,
+        Abelian = 2,
+        Cyclic = 4,
+        Simple = 8,
+        Dedekind = 16,
+        Hamiltonian = 32
+    };
+
+    uint8_t flags;
+    uint32_t subgroups;             // Proper non-trivial, as in Classifier::GetSubGroups()
+    uint32_t normalSubgroups;       // Proper non-trivial
+    uint32_t cyclicSubgroups;       // Non-trivial
+    uint32_t maximalCyclic;         // The cycles of the cycle graph
+};
+
+/**
+ * @brief Computes the properties of stored tables (files in the format
+ * of the merge command) in parallel threads.
+ *
+ * The tables are loaded first, then the threads take chunks of them
+ * through an atomic counter. Each thread keeps its CycleGraph between
+ * the tables, and the results are stored by the index of the table, so
+ * the output is in the input order for any number of threads.
+ *
+ * The subgroups are counted on Classifier::GetSubgroupLattice() instead
+ * of the exponential GetSubGroups(). The properties have the meaning of
+ * the Classifier functions: Simple, Dedekind and Hamiltonian are decided
+ * on the proper non-trivial subgroups. A table which is not associative
+ * only gets the Abelian flag.
+ *
+ * Binary output: "GRPPROP1", the order and the number of tables as
+ * 32 bit little-endian integers, then 17 bytes per table: the flags
+ * and the four counts (32 bit little-endian).
+ */
+class BatchAnalyzer {
+    private:
+        int order;
+        std::vector<uint8_t> tables;
+        size_t count;
+        std::vector<TableProperties> results;
+        std::vector<uint64_t> threadTables;
+        std::atomic<size_t> next;
+        double seconds;
+        int threads;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        static const size_t chunk = 16;
+
+        void Worker(int index) {
+            try {
+                this->Work(index);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(this->errorMutex);
+
+                if (!this->error) {
+                    this->error = std::current_exception();
+                }
+
+                /*
+                    Stop the other threads too.
+                */
+                this->next = this->count;
+            }
+        }
+
+        void Work(int index) {
+            int size = this->order * this->order;
+            std::vector<uint8_t> cayley(size);
+            CycleGraph graph;
+            size_t start;
+
+            while((start = this->next.fetch_add(BatchAnalyzer::chunk)) < this->count) {
+                size_t end = std::min(start + BatchAnalyzer::chunk, this->count);
+
+                for(size_t i = start; i < end; i++) {
+                    /*
+                        The Classifier needs a writable table.
+                    */
+                    std::copy(&this->tables[i * size], &this->tables[i * size] + size, cayley.begin());
+                    BatchAnalyzer::Analyze(this->order, &cayley[0], graph, this->results[i]);
+                }
+
+                this->threadTables[index] += end - start;
+            }
+        }
+
+        static void WriteUint32(std::ostream &output, uint32_t value) {
+            char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+            output.write(bytes, 4);
+        }
+
+    public:
+        /**
+         * @brief The properties of a single table. The graph is only
+         * used as working memory, so it can be reused between the calls.
+         */
+        static void Analyze(int order, uint8_t *cayley, CycleGraph &graph, TableProperties &result) {
+            Classifier classifier(order, cayley);
+            result = TableProperties();
+
+            if (classifier.IsAbelian()) {
+                result.flags |= TableProperties::Abelian;
+            }
+
+            if (!classifier.IsAssociative()) {
+                return;
+            }
+
+            result.flags |= TableProperties::Associative;
+
+            graph.Build(order, cayley);
+            result.maximalCyclic = graph.GetMaximalCycles().size();
+
+            for(int e = 2; e <= order; e++) {
+                if (graph.GetElementOrder(e) == order) {
+                    result.flags |= TableProperties::Cyclic;
+                    break;
+                }
+            }
+
+            std::vector<Classifier::ElementSet> lattice = classifier.GetSubgroupLattice();
+            Classifier::ElementSet all = classifier.GetAllElements();
+            bool dedekind = true;
+
+            for(const Classifier::ElementSet &subgroup : lattice) {
+                size_t size = subgroup.count();
+
+                if (size == 1 || (int)size == order) {
+                    continue;
+                }
+
+                result.subgroups++;
+
+                if (classifier.IsNormal(subgroup, all)) {
+                    result.normalSubgroups++;
+                } else {
+                    dedekind = false;
+                }
+            }
+
+            /*
+                A cyclic subgroup of order d has phi(d) generators.
+            */
+            std::vector<uint32_t> elementsOfOrder(order + 1, 0);
+
+            for(int e = 2; e <= order; e++) {
+                elementsOfOrder[graph.GetElementOrder(e)]++;
+            }
+
+            for(int d = 2; d <= order; d++) {
+                int phi = d;
+
+                for(int p = 2, rest = d; p <= rest; p++) {
+                    if (rest % p == 0) {
+                        phi -= phi / p;
+
+                        while(rest % p == 0) {
+                            rest /= p;
+                        }
+                    }
+                }
+
+                result.cyclicSubgroups += elementsOfOrder[d] / phi;
+            }
+
+            if (result.normalSubgroups == 0) {
+                result.flags |= TableProperties::Simple;
+            }
+
+            if (dedekind) {
+                result.flags |= TableProperties::Dedekind;
+
+                if (!(result.flags & TableProperties::Abelian)) {
+                    result.flags |= TableProperties::Hamiltonian;
+                }
+            }
+        }
+
+        BatchAnalyzer(int order) : order(order), count(0), next(0), seconds(0), threads(0) {
+            if (order < 1 || order > 255) {
+                throw std::runtime_error("Invalid order value. Allowed: 1 -> 255");
+            }
+        }
+
+        /**
+         * @brief Loads the tables of a file.
+         */
+        void AddFile(const std::string &path) {
+            std::ifstream input(path.c_str());
+            int size = this->order * this->order;
+
+            if (!input) {
+                throw std::runtime_error("Can't open file: " + path);
+            }
+
+            while(true) {
+                this->tables.resize((this->count + 1) * size);
+
+                if (!WorkUnit::ReadTable(input, this->order, &this->tables[this->count * size])) {
+                    break;
+                }
+
+                this->count++;
+            }
+
+            this->tables.resize(this->count * size);
+        }
+
+        /**
+         * @brief Loads a file, or the files of a directory in the order of their names.
+         */
+        void AddPath(const std::string &path) {
+            struct stat info;
+
+            if (stat(path.c_str(), &info) != 0) {
+                throw std::runtime_error("Can't open: " + path);
+            }
+
+            if (!S_ISDIR(info.st_mode)) {
+                this->AddFile(path);
+                return;
+            }
+
+            DIR *dir = opendir(path.c_str());
+            std::vector<std::string> names;
+            struct dirent *entry;
+
+            if (dir == nullptr) {
+                throw std::runtime_error("Unable to open directory: " + path);
+            }
+
+            while((entry = readdir(dir)) != nullptr) {
+                std::string name(entry->d_name);
+
+                if (name[0] != '.' && stat((path + "/" + name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                    names.push_back(name);
+                }
+            }
+
+            closedir(dir);
+            std::sort(names.begin(), names.end());
+
+            for(const std::string &name : names) {
+                this->AddFile(path + "/" + name);
+            }
+        }
+
+        /**
+         * @brief Analyzes the loaded tables. (0 threads: one per core)
+         */
+        void Run(int threads) {
+            if (threads < 1) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> workers;
+
+            this->threads = threads;
+            this->results.assign(this->count, TableProperties());
+            this->threadTables.assign(threads, 0);
+            this->next = 0;
+
+            for(int i = 0; i < threads; i++) {
+                workers.push_back(std::thread(&BatchAnalyzer::Worker, this, i));
+            }
+
+            for(std::thread &worker : workers) {
+                worker.join();
+            }
+
+            this->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (this->error) {
+                std::rethrow_exception(this->error);
+            }
+        }
+
+        size_t GetTableCount() const {
+            return this->count;
+        }
+
+        const TableProperties& GetProperties(size_t index) const {
+            return this->results[index];
+        }
+
+        void WriteCsv(std::ostream &output) const {
+            TableWriter writer;
+            static const char *names[] = { "associative", "abelian", "cyclic", "simple", "dedekind", "hamiltonian" };
+
+            writer.Append("table");
+
+            for(const char *name : names) {
+                writer.Append(',');
+                writer.Append(name);
+            }
+
+            writer.Append(",subgroups,normal_subgroups,cyclic_subgroups,maximal_cyclic_subgroups\n");
+
+            for(size_t i = 0; i < this->results.size(); i++) {
+                const TableProperties &result = this->results[i];
+                std::string index = std::to_string(i + 1);
+                writer.Append(index.data(), index.size());
+
+                for(int bit = 0; bit < 6; bit++) {
+                    writer.Append(',');
+                    writer.Append((result.flags >> bit) & 1 ? '1' : '0');
+                }
+
+                uint32_t counts[4] = { result.subgroups, result.normalSubgroups,
+                    result.cyclicSubgroups, result.maximalCyclic };
+
+                for(uint32_t value : counts) {
+                    writer.Append(',');
+                    writer.AppendNumber(value);
+                }
+
+                writer.Append('\n');
+
+                if (writer.GetSize() >= 65536) {
+                    writer.Flush(output);
+                }
+            }
+
+            writer.Flush(output);
+        }
+
+        void WriteBinary(std::ostream &output) const {
+            output.write("GRPPROP1", 8);
+            BatchAnalyzer::WriteUint32(output, this->order);
+            BatchAnalyzer::WriteUint32(output, this->results.size());
+
+            for(const TableProperties &result : this->results) {
+                output.put(result.flags);
+                BatchAnalyzer::WriteUint32(output, result.subgroups);
+                BatchAnalyzer::WriteUint32(output, result.normalSubgroups);
+                BatchAnalyzer::WriteUint32(output, result.cyclicSubgroups);
+                BatchAnalyzer::WriteUint32(output, result.maximalCyclic);
+            }
+        }
+
+        /**
+         * @brief Throughput and the number of tables per thread.
+         */
+        void PrintStats(std::ostream &output) const {
+            output << "Tables: " << this->count << ", threads: " << this->threads << ", "
+                << this->seconds << " s, " << (this->seconds > 0 ? this->count / this->seconds : 0)
+                << " tables/s\nTables per thread:";
+
+            for(uint64_t tables : this->threadTables) {
+                output << ' ' << tables;
+            }
+
+            output << '\n';
+        }
+};
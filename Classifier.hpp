@@ -20,14 +20,75 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <bitset>
+#include <unordered_set>
+#include <stdexcept>
 #include "Combinator.hpp"
+#include "TableWriter.hpp"
 
 class Classifier {
+    public:
+        /**
+         * @brief Set of elements: bit i is the element i + 1.
+         */
+        typedef std::bitset<256> ElementSet;
+
     private:
         int order;
         uint8_t *cayley;
         std::string message;
-    
+
+        inline int Mult(int a, int b) const {
+            return this->cayley[a * this->order + b] - 1;
+        }
+
+        std::vector<int> GetInverses() const {
+            std::vector<int> inverse(this->order);
+
+            for(int g = 0; g < this->order; g++) {
+                for(int h = 0; h < this->order; h++) {
+                    if (this->Mult(g, h) == 0) {
+                        inverse[g] = h;
+                        break;
+                    }
+                }
+            }
+
+            return inverse;
+        }
+
+        /**
+         * @brief The smallest subgroup containing the set, which is normal in "within".
+         */
+        ElementSet NormalClosure(const ElementSet &set, const ElementSet &within) const {
+            std::vector<int> inverse = this->GetInverses();
+            ElementSet conjugates;
+
+            for(int g = 0; g < this->order; g++) {
+                if (!within.test(g)) {
+                    continue;
+                }
+
+                for(int s = 0; s < this->order; s++) {
+                    if (set.test(s)) {
+                        conjugates.set(this->Mult(this->Mult(g, s), inverse[g]));
+                    }
+                }
+            }
+
+            return this->Generate(conjugates);
+        }
+
+        static void AddUnique(std::vector<ElementSet> &sets, const ElementSet &set) {
+            for(const ElementSet &existing : sets) {
+                if (existing == set) {
+                    return;
+                }
+            }
+
+            sets.push_back(set);
+        }
+
     public:
         Classifier(int order, uint8_t *cayley) {
             this->order = order;
@@ -209,70 +270,78 @@ class Classifier {
             return normalSubgroups;
         }
 
-        std::string PrintSubgroups(std::vector<std::vector<uint8_t>> &subgroups) const {
-            std::stringstream o;
-
-            if (subgroups.size() < 1) {
-                return std::string();
-            }
-
+        /**
+         * @brief The Markdown tables of the subgroups.
+         */
+        void WriteSubgroups(TableWriter &writer, const std::vector<std::vector<uint8_t>> &subgroups) const {
             for(const auto &group : subgroups) {
-                o << "\n| * |";
+                writer.Append("\n| * |", 6);
 
                 for(const uint8_t &e1 : group) {
-                    o << (int)e1 << "|";
-                }
-
-                o << "\n|";
-
-                for(unsigned int i = 0; i <= group.size(); i++) {
-                    o << " --- |";
+                    writer.AppendNumber(e1);
+                    writer.Append('|');
                 }
 
-                o << "\n";
+                writer.Append("\n|", 2);
+                writer.AppendSeparator(group.size() + 1);
+                writer.Append('\n');
 
                 for(const uint8_t &e1 : group) {
-                    o << "|<b>" << (int)e1 << "</b>|";
+                    writer.Append("|<b>", 4);
+                    writer.AppendNumber(e1);
+                    writer.Append("</b>|", 5);
 
                     for(const uint8_t &e2 : group) {
-                        o << (int)this->cayley[(e1 - 1) * this->order + e2 - 1] << "|";
+                        writer.AppendNumber(this->cayley[(e1 - 1) * this->order + e2 - 1]);
+                        writer.Append('|');
                     }
 
-                    o << '\n';
+                    writer.Append('\n');
                 }
             }
-
-            return o.str();
         }
 
-        std::string PrintGroup() const {
-            std::stringstream o;
-
-            o << "\n| * |";
+        std::string PrintSubgroups(std::vector<std::vector<uint8_t>> &subgroups) const {
+            TableWriter writer;
+            this->WriteSubgroups(writer, subgroups);
 
-            for(int i = 1; i <= this->order; i++) {
-                o << i << "|";
-            }
+            return writer.ToString();
+        }
 
-            o << "\n|";
+        /**
+         * @brief The Markdown table of the group.
+         */
+        void WriteGroup(TableWriter &writer) const {
+            writer.Append("\n| * |", 6);
 
-            for(int i = 0; i <= this->order; i++) {
-                o << " --- |";
+            for(int i = 1; i <= this->order; i++) {
+                writer.AppendNumber(i);
+                writer.Append('|');
             }
 
-            o << "\n";
+            writer.Append("\n|", 2);
+            writer.AppendSeparator(this->order + 1);
+            writer.Append('\n');
 
             for(int i = 0; i < this->order; i++) {
-                o << "|<b>" << (i + 1) << "</b>|";
+                writer.Append("|<b>", 4);
+                writer.AppendNumber(i + 1);
+                writer.Append("</b>|", 5);
 
                 for(int j = 0; j < this->order; j++) {
-                    o << (int)this->cayley[i * this->order + j] << "|";
+                    writer.AppendNumber(this->cayley[i * this->order + j]);
+                    writer.Append('|');
                 }
 
-                o << '\n';
+                writer.Append('\n');
             }
+        }
 
-            return o.str();
+        std::string PrintGroup() const {
+            TableWriter writer;
+            this->WriteGroup(writer);
+
+            return writer.ToString();
         }
 
         bool IsDedekind() {
@@ -326,34 +395,475 @@ class Classifier {
             return false;
         }
 
-        std::string PrintAllProperties() {
-            std::stringstream o;
+        ElementSet GetAllElements() const {
+            ElementSet all;
+
+            for(int i = 0; i < this->order; i++) {
+                all.set(i);
+            }
+
+            return all;
+        }
+
+        /**
+         * @brief The subgroup generated by the elements. O(n * |generators|)
+         */
+        ElementSet Generate(const ElementSet &generators) const {
+            std::vector<int> gens;
+
+            for(int g = 1; g < this->order; g++) {
+                if (generators.test(g)) {
+                    gens.push_back(g);
+                }
+            }
+
+            return this->Generate(gens);
+        }
+
+        /**
+         * @brief The subgroup generated by the elements. (0-based) O(n * |generators|)
+         */
+        ElementSet Generate(const std::vector<int> &generators) const {
+            ElementSet result;
+            std::vector<int> elements(1, 0);
+            result.set(0);
+
+            for(size_t i = 0; i < elements.size(); i++) {
+                for(int g : generators) {
+                    int product = this->Mult(elements[i], g);
+
+                    if (!result.test(product)) {
+                        result.set(product);
+                        elements.push_back(product);
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief All subgroups, including {1} and G. Without the subset
+         * enumeration of GetSubGroups(): each subgroup is the join of its
+         * cyclic subgroups, so they are all reached by joining the known
+         * subgroups with the cyclic ones. A join is generated from the
+         * few generators of the subgroup plus one element.
+         * O(subgroups * cyclic subgroups * n log n)
+         */
+        std::vector<ElementSet> GetSubgroupLattice() const {
+            std::vector<ElementSet> subgroups(1, ElementSet(1));
+            std::vector<std::vector<int>> generators(1);
+            std::vector<int> cyclic;        // One generator of each cyclic subgroup
+            std::unordered_set<ElementSet> known(subgroups.begin(), subgroups.end());
+
+            for(int g = 1; g < this->order; g++) {
+                std::vector<int> gens(1, g);
+                ElementSet subgroup = this->Generate(gens);
+
+                if (known.insert(subgroup).second) {
+                    subgroups.push_back(subgroup);
+                    generators.push_back(gens);
+                    cyclic.push_back(g);
+                }
+            }
+
+            for(size_t i = 1; i < subgroups.size(); i++) {
+                for(int g : cyclic) {
+                    if (subgroups[i].test(g)) {
+                        continue;
+                    }
+
+                    std::vector<int> gens(generators[i]);
+                    gens.push_back(g);
+                    ElementSet join = this->Generate(gens);
+
+                    if (known.insert(join).second) {
+                        subgroups.push_back(join);
+                        generators.push_back(gens);
+                    }
+                }
+            }
+
+            return subgroups;
+        }
+
+        /**
+         * @brief Elements which commute with every element. O(n^2)
+         */
+        ElementSet GetCenter() const {
+            ElementSet center;
+
+            for(int a = 0; a < this->order; a++) {
+                int b;
+
+                for(b = 0; b < this->order; b++) {
+                    if (this->Mult(a, b) != this->Mult(b, a)) {
+                        break;
+                    }
+                }
+
+                if (b == this->order) {
+                    center.set(a);
+                }
+            }
+
+            return center;
+        }
+
+        /**
+         * @brief [A, B]: the subgroup generated by the commutators
+         * a^-1 b^-1 a b. O(|A| |B| + n^2)
+         */
+        ElementSet GetCommutator(const ElementSet &a, const ElementSet &b) const {
+            std::vector<int> inverse = this->GetInverses();
+            ElementSet commutators;
+
+            for(int x = 0; x < this->order; x++) {
+                if (!a.test(x)) {
+                    continue;
+                }
+
+                for(int y = 0; y < this->order; y++) {
+                    if (b.test(y)) {
+                        commutators.set(this->Mult(this->Mult(inverse[x], inverse[y]), this->Mult(x, y)));
+                    }
+                }
+            }
+
+            return this->Generate(commutators);
+        }
+
+        /**
+         * @brief G, G', G'', ... until it doesn't change.
+         */
+        std::vector<ElementSet> GetDerivedSeries() const {
+            std::vector<ElementSet> series(1, this->GetAllElements());
+
+            while(true) {
+                ElementSet next = this->GetCommutator(series.back(), series.back());
+
+                if (next == series.back()) {
+                    return series;
+                }
+
+                series.push_back(next);
+            }
+        }
+
+        /**
+         * @brief G, [G, G], [[G, G], G], ... until it doesn't change.
+         */
+        std::vector<ElementSet> GetLowerCentralSeries() const {
+            ElementSet all = this->GetAllElements();
+            std::vector<ElementSet> series(1, all);
+
+            while(true) {
+                ElementSet next = this->GetCommutator(series.back(), all);
+
+                if (next == series.back()) {
+                    return series;
+                }
+
+                series.push_back(next);
+            }
+        }
+
+        /**
+         * @brief {1}, Z(G), Z2(G), ... until it doesn't change.
+         * Z(i+1) = elements g with [g, x] in Z(i) for every x. O(n^2) per step.
+         */
+        std::vector<ElementSet> GetUpperCentralSeries() const {
+            std::vector<int> inverse = this->GetInverses();
+            std::vector<ElementSet> series(1, ElementSet(1));
+
+            while(true) {
+                const ElementSet &current = series.back();
+                ElementSet next;
+
+                for(int g = 0; g < this->order; g++) {
+                    int x;
+
+                    for(x = 0; x < this->order; x++) {
+                        if (!current.test(this->Mult(this->Mult(inverse[g], inverse[x]), this->Mult(g, x)))) {
+                            break;
+                        }
+                    }
+
+                    if (x == this->order) {
+                        next.set(g);
+                    }
+                }
+
+                if (next == current) {
+                    return series;
+                }
+
+                series.push_back(next);
+            }
+        }
+
+        /**
+         * @brief The derived series reaches {1}.
+         */
+        bool IsSolvable() const {
+            return this->GetDerivedSeries().back().count() == 1;
+        }
+
+        /**
+         * @brief The upper central series reaches G.
+         */
+        bool IsNilpotent() const {
+            return (int)this->GetUpperCentralSeries().back().count() == this->order;
+        }
+
+        /**
+         * @brief True if the subgroup is normal in the group "within". O(|within| * |subgroup|)
+         */
+        bool IsNormal(const ElementSet &subgroup, const ElementSet &within) const {
+            std::vector<int> inverse = this->GetInverses();
+
+            for(int g = 0; g < this->order; g++) {
+                if (!within.test(g)) {
+                    continue;
+                }
+
+                for(int n = 0; n < this->order; n++) {
+                    if (subgroup.test(n) && !subgroup.test(this->Mult(this->Mult(g, n), inverse[g]))) {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief The table of G/N. The cosets are numbered in the order of
+         * their smallest elements, so N is 1. (1-based values)
+         */
+        std::vector<uint8_t> GetQuotient(const ElementSet &normal, int &quotientOrder) const {
+            if (!normal.test(0) || this->Generate(normal) != normal || !this->IsNormal(normal, this->GetAllElements())) {
+                throw std::runtime_error("GetQuotient: not a normal subgroup.");
+            }
+
+            std::vector<int> coset(this->order, -1);
+            std::vector<int> representatives;
+
+            for(int g = 0; g < this->order; g++) {
+                if (coset[g] >= 0) {
+                    continue;
+                }
+
+                for(int n = 0; n < this->order; n++) {
+                    if (normal.test(n)) {
+                        coset[this->Mult(g, n)] = representatives.size();
+                    }
+                }
+
+                representatives.push_back(g);
+            }
+
+            quotientOrder = representatives.size();
+            std::vector<uint8_t> table(quotientOrder * quotientOrder);
+
+            for(int i = 0; i < quotientOrder; i++) {
+                for(int j = 0; j < quotientOrder; j++) {
+                    table[i * quotientOrder + j] = coset[this->Mult(representatives[i], representatives[j])] + 1;
+                }
+            }
+
+            return table;
+        }
+
+        /**
+         * @brief G = G0 > G1 > ... > {1}, each one a maximal normal subgroup
+         * of the previous, so the factors are simple.
+         *
+         * The normal subgroups of each Gi are the joins of the normal
+         * closures of its elements. The largest proper one is maximal.
+         */
+        std::vector<ElementSet> GetCompositionSeries() const {
+            std::vector<ElementSet> series(1, this->GetAllElements());
+
+            while(series.back().count() > 1) {
+                ElementSet group = series.back();
+                std::vector<ElementSet> normals;
+
+                for(int g = 1; g < this->order; g++) {
+                    if (group.test(g)) {
+                        ElementSet single;
+                        single.set(g);
+                        Classifier::AddUnique(normals, this->NormalClosure(single, group));
+                    }
+                }
+
+                for(size_t i = 0; i < normals.size(); i++) {
+                    for(size_t j = 0; j < i; j++) {
+                        Classifier::AddUnique(normals, this->Generate(normals[i] | normals[j]));
+                    }
+                }
 
+                ElementSet largest(1);
+
+                for(const ElementSet &normal : normals) {
+                    if (normal != group && normal.count() > largest.count()) {
+                        largest = normal;
+                    }
+                }
+
+                series.push_back(largest);
+            }
+
+            return series;
+        }
+
+        /**
+         * @brief Elements g with g * sub * g^-1 = sub. O(n * |sub|)
+         */
+        ElementSet GetNormalizer(const ElementSet &subgroup) const {
+            std::vector<int> inverse = this->GetInverses();
+            ElementSet normalizer;
+
+            for(int g = 0; g < this->order; g++) {
+                int s;
+
+                for(s = 0; s < this->order; s++) {
+                    if (subgroup.test(s) && !subgroup.test(this->Mult(this->Mult(g, s), inverse[g]))) {
+                        break;
+                    }
+                }
+
+                if (s == this->order) {
+                    normalizer.set(g);
+                }
+            }
+
+            return normalizer;
+        }
+
+        /**
+         * @brief A Sylow p-subgroup. (Trivial if p doesn't divide the order.)
+         *
+         * Grows a p-subgroup P one factor p at a time: while P is not Sylow,
+         * p divides |N(P) : P|, so there is a g in N(P) \ P with g^p in P,
+         * and <P, g> has order p |P|. O(n^2) per step.
+         */
+        ElementSet GetSylowSubgroup(int p) const {
+            ElementSet sylow(1);
+            int target = 1;
+
+            while(this->order % (target * p) == 0) {
+                target *= p;
+            }
+
+            while((int)sylow.count() < target) {
+                ElementSet normalizer = this->GetNormalizer(sylow);
+                int g;
+
+                for(g = 1; g < this->order; g++) {
+                    if (!normalizer.test(g) || sylow.test(g)) {
+                        continue;
+                    }
+
+                    int power = g;
+
+                    for(int i = 1; i < p; i++) {
+                        power = this->Mult(power, g);
+                    }
+
+                    if (sylow.test(power)) {
+                        break;
+                    }
+                }
+
+                if (g == this->order) {
+                    throw std::runtime_error("GetSylowSubgroup: the table is not a group.");
+                }
+
+                sylow.set(g);
+                sylow = this->Generate(sylow);
+            }
+
+            return sylow;
+        }
+
+        /**
+         * @brief n_p: the number of Sylow p-subgroups, which are the
+         * conjugates of one. (The index of its normalizer.)
+         */
+        int GetSylowCount(int p) const {
+            return this->order / this->GetNormalizer(this->GetSylowSubgroup(p)).count();
+        }
+
+        /**
+         * @brief The prime divisors of the order.
+         */
+        std::vector<int> GetPrimeDivisors() const {
+            std::vector<int> primes;
+            int rest = this->order;
+
+            for(int p = 2; p <= rest; p++) {
+                if (rest % p == 0) {
+                    primes.push_back(p);
+
+                    while(rest % p == 0) {
+                        rest /= p;
+                    }
+                }
+            }
+
+            return primes;
+        }
+
+        /**
+         * @brief The elements of a set, as in GetSubGroups(). (1-based)
+         */
+        static std::vector<uint8_t> ToElements(const ElementSet &set) {
+            std::vector<uint8_t> elements;
+
+            for(int i = 0; i < 256; i++) {
+                if (set.test(i)) {
+                    elements.push_back(i + 1);
+                }
+            }
+
+            return elements;
+        }
+
+        /**
+         * @brief The properties in one line, without a newline.
+         */
+        void WriteAllProperties(TableWriter &writer) {
             if (!this->IsAssociative()) {
-                o << "Not associative. ";
+                writer.Append("Not associative. ");
             }
 
             if (this->IsAbelian()) {
-                o << "Abelian.";
+                writer.Append("Abelian.");
             } else {
-                o << "Non-abelian.";
+                writer.Append("Non-abelian.");
             }
 
             if (this->IsCyclic()) {
-                o << " Cyclic.";
+                writer.Append(" Cyclic.");
             }
 
             if (this->IsSimple()) {
-                o << " Simple.";
+                writer.Append(" Simple.");
             }
 
             if (this->IsHamiltonian()) {
-                o << " Hamiltonian.";
+                writer.Append(" Hamiltonian.");
             }
             else if (this->IsDedekind()) {
-                o << " Dedekind.";
+                writer.Append(" Dedekind.");
             }
+        }
+
+        std::string PrintAllProperties() {
+            TableWriter writer;
+            this->WriteAllProperties(writer);
 
-            return o.str();
+            return writer.ToString();
         }
 };
@@ -16,34 +16,81 @@
 #pragma once
 
 #include <stdint.h>
-#include <list>
-#include <map>
 #include <vector>
 #include <stdexcept>
-#include <unordered_set>
 #include <string>
-#include <sstream>
+#include "TableWriter.hpp"
 
 /**
  * @brief Generates Graphviz dot code for the cycle graph of the group.
+ *
+ * The cycle of an element is its power sequence without the identity.
+ * All of them are stored in one array, the cycle of element e is the
+ * range [start[e], start[e + 1]). The cycles are grouped by length as
+ * ranges of the "byLength" array (shortest first, then by element).
+ *
+ * containing[v] is a bitset of the elements whose cycle contains v
+ * (words of 64 bits, for orders up to 255). The cycle of e is part of
+ * the cycle of f if and only if e is in it (the cycle of f and the
+ * identity form a subgroup), so the maximal cycles are found in one pass
+ * from the longest to the shortest: e is maximal if no maximal cycle
+ * found before contains it.
+ *
+ * Build() reuses the arrays, so a CycleGraph kept by a thread doesn't
+ * allocate memory after the first table of the largest order.
  */
 class CycleGraph {
     private:
         int order;
-        int size;
-        // Cycles are grouped by length
-        std::map<int, std::list<std::list<int>>*> cycles;
-        std::vector<uint32_t> cyclesByValues;
+        int words;                              // 64 bit words per bitset
+        std::vector<uint8_t> powers;            // The cycles of the elements 2 -> order
+        std::vector<uint32_t> start;            // [element] -> position in "powers"
+        std::vector<uint8_t> byLength;          // Elements ordered by the length of their cycles
+        std::vector<uint32_t> lengthStart;      // [length] -> position in "byLength"
+        std::vector<uint64_t> containing;       // [value * words + word]
+        std::vector<uint64_t> added;
+        std::vector<uint8_t> maximal;           // Maximal cycles from the longest to the shortest
+
+        inline int CycleLength(int element) const {
+            return this->start[element + 1] - this->start[element];
+        }
+
+        inline const uint8_t* Cycle(int element) const {
+            return &this->powers[0] + this->start[element];
+        }
 
     public:
-        CycleGraph(int order, uint8_t *cayley) : cycles(), cyclesByValues(order + 1) {
+        CycleGraph() : order(0), words(0) { }
+
+        CycleGraph(int order, const uint8_t *cayley) : order(0), words(0) {
+            this->Build(order, cayley);
+        }
+
+        /**
+         * @brief Computes the cycles of the table. (Replaces the previous one.)
+         */
+        void Build(int order, const uint8_t *cayley) {
+            if (order < 1 || order > 255) {
+                throw std::runtime_error("CycleGraph: invalid order. Allowed: 1 -> 255");
+            }
+
             this->order = order;
-            this->size = order * order;
+            this->words = (order + 63) >> 6;
+            this->powers.resize(order * order);
+            this->start.assign(order + 2, 0);
+            this->byLength.resize(order);
+            this->lengthStart.assign(order + 1, 0);
+            this->containing.assign((order + 1) * this->words, 0);
+            this->added.assign(this->words, 0);
+            this->maximal.clear();
+
+            uint32_t position = 0;
 
             for(int element = 2; element <= order; element++) {
-                std::list<int> newCycle;
                 int current = element;
-                this->cyclesByValues[1] |= ((uint32_t)1) << (element - 1);
+                uint64_t bit = (uint64_t)1 << ((element - 1) & 63);
+                int word = (element - 1) >> 6;
+                this->start[element] = position;
 
                 /*
                     By Lagrange's theorem we should get back to
@@ -51,182 +98,166 @@ class CycleGraph {
                     power sequence. If not than the input is not
                     the Cayley table of a proper symmetry group.
                 */
-                int limit = this->order;
+                int limit = order;
 
                 while(current != 1) {
                     if (limit-- == 0) {
                         throw std::runtime_error("CycleGraph: The Cayley table is invalid.");
                     }
 
-                    newCycle.push_back(current);
-                    this->cyclesByValues[current] |= ((uint32_t)1) << (element - 1);
+                    this->powers[position++] = current;
+                    this->containing[current * this->words + word] |= bit;
 
                     // current = current * element
-                    current = *(cayley + (current - 1) * order + element - 1);
+                    current = cayley[(current - 1) * order + element - 1];
                 }
-
-                if (newCycle.size() > 0) {
-                    /*
-                        Store it
-                    */
-                    auto cycleGroupIter = this->cycles.find(newCycle.size());
-                    std::list<std::list<int>> *cycleGroup;
-
-                    if (cycleGroupIter == this->cycles.end()) {
-                        cycleGroup = new std::list<std::list<int>>();
-                        this->cycles.insert({newCycle.size(), cycleGroup});
-                    } else {
-                        cycleGroup = cycleGroupIter->second;
-                    }
-
-                    cycleGroup->push_back(newCycle);
-                }
-            }
-        }
-
-        ~CycleGraph() {
-            for (const auto &iter : this->cycles) {
-                delete iter.second;
             }
-        }
 
-        /**
-         * @brief Generate text code for Graphviz.
-         */
-        std::string GetGraphVizCode() {
-            std::stringstream code;
-            uint32_t added = 0;
-            auto cycleGroupIter = this->cycles.end();
+            this->start[order + 1] = position;
 
-            code << "strict graph Group {\n";
-            code << "    node [shape=circle, fontsize=6, fixedsize=true, width=0.2]\n";
-            code << "    1 [style=filled]\n\n";
+            /*
+                Group the cycles by length (counting sort)
+            */
+            for(int element = 2; element <= order; element++) {
+                this->lengthStart[this->CycleLength(element)]++;
+            }
 
-            do {
-                /*
-                    Progress from the longest cycles to the shortest.
-                */
-                cycleGroupIter--;
+            uint32_t sum = 0;
 
-                for(const auto &cycle : *(cycleGroupIter->second)) {
-                    uint32_t cycleID =(uint32_t)1 << (*cycle.begin() - 1);
+            for(int length = 0; length <= order; length++) {
+                uint32_t count = this->lengthStart[length];
+                this->lengthStart[length] = sum;
+                sum += count;
+            }
 
-                    /*
-                        Check if the cycle is already contained by another one.
-                    */
-                    uint32_t test = 0xFFFFFFFFU;
-                    for(int element : cycle) {
-                        test &= this->cyclesByValues[element];
+            for(int element = 2; element <= order; element++) {
+                this->byLength[this->lengthStart[this->CycleLength(element)]++] = element;
+            }
 
-                        if (!test) {
+            /*
+                Now lengthStart[length] is the end of the group of the
+                length. Find the maximal cycles from the longest group.
+            */
+            for(int length = order - 1; length >= 1; length--) {
+                for(uint32_t i = this->lengthStart[length - 1]; i < this->lengthStart[length]; i++) {
+                    int element = this->byLength[i];
+                    const uint64_t *test = &this->containing[element * this->words];
+                    bool contained = false;
+
+                    for(int w = 0; w < this->words; w++) {
+                        if (test[w] & this->added[w]) {
+                            contained = true;
                             break;
                         }
                     }
 
-                    if (test & added) {
-                        continue;
-                    }
-                    
-                    /*
-                        Print cycle
-                    */
-                    added |= cycleID;
-                    code << "    1 -- ";
-
-                    for (int element : cycle) {
-                        code << element << " -- ";
+                    if (!contained) {
+                        this->added[(element - 1) >> 6] |= (uint64_t)1 << ((element - 1) & 63);
+                        this->maximal.push_back(element);
                     }
-
-                    code << "1\n";
                 }
-            } while(cycleGroupIter != this->cycles.begin());
-
-            code << "}\n";
-
-            return code.str();
+            }
         }
 
-        std::string GetCsAcademyCode() {
-            std::stringstream code;
-            uint32_t added = 0;
-            auto cycleGroupIter = this->cycles.end();
+        /**
+         * @brief Order of the element. (1-based)
+         */
+        int GetElementOrder(int element) const {
+            return element == 1 ? 1 : this->CycleLength(element) + 1;
+        }
 
-            do {
-                /*
-                    Progress from the longest cycles to the shortest.
-                */
-                cycleGroupIter--;
+        /**
+         * @brief The generators of the maximal cyclic subgroups, from the
+         * longest cycle to the shortest.
+         */
+        const std::vector<uint8_t>& GetMaximalCycles() const {
+            return this->maximal;
+        }
 
-                for(const auto &cycle : *(cycleGroupIter->second)) {
-                    uint32_t cycleID =(uint32_t)1 << (*cycle.begin() - 1);
+        /**
+         * @brief Generate text code for Graphviz.
+         */
+        void WriteGraphVizCode(TableWriter &writer) const {
+            writer.Append("strict graph Group {\n");
+            writer.Append("    node [shape=circle, fontsize=6, fixedsize=true, width=0.2]\n");
+            writer.Append("    1 [style=filled]\n\n");
+
+            for(int element : this->maximal) {
+                const uint8_t *cycle = this->Cycle(element);
+                writer.Append("    1 -- ", 9);
+
+                for(int i = 0; i < this->CycleLength(element); i++) {
+                    writer.AppendNumber(cycle[i]);
+                    writer.Append(" -- ", 4);
+                }
 
-                    /*
-                        Check if the cycle is already contained by another one.
-                    */
-                    uint32_t test = 0xFFFFFFFFU;
-                    for(int element : cycle) {
-                        test &= this->cyclesByValues[element];
+                writer.Append("1\n", 2);
+            }
 
-                        if (!test) {
-                            break;
-                        }
-                    }
+            writer.Append("}\n", 2);
+        }
 
-                    if (test & added) {
-                        continue;
-                    }
-                    
-                    /*
-                        Print cycle
-                    */
-                    added |= cycleID;
-
-                    for(auto iter = cycle.begin(); iter != cycle.end(); iter++) {
-                        if (iter == cycle.begin()) {
-                            code << "1 " << *iter << '\n';
-                        }
+        void WriteCsAcademyCode(TableWriter &writer) const {
+            for(int element : this->maximal) {
+                const uint8_t *cycle = this->Cycle(element);
+                int length = this->CycleLength(element);
 
-                        auto next = std::next(iter);
+                writer.Append("1 ", 2);
+                writer.AppendNumber(cycle[0]);
+                writer.Append('\n');
 
-                        if (next == cycle.end()) {
-                            code << *iter << " 1\n";
-                            break;
-                        }
+                for(int i = 0; i + 1 < length; i++) {
+                    writer.AppendNumber(cycle[i]);
+                    writer.Append(' ');
+                    writer.AppendNumber(cycle[i + 1]);
+                    writer.Append('\n');
+                }
 
-                        code << *iter << ' ' << *next << '\n';
-                    }
+                writer.AppendNumber(cycle[length - 1]);
+                writer.Append(" 1\n\n", 4);
+            }
+        }
 
-                    code << '\n';
+        void WriteCyclicSubgroups(TableWriter &writer) const {
+            /*
+                Progress from the shortest cycles to the longest.
+            */
+            for(int i = 0; i < this->order - 1; i++) {
+                int element = this->byLength[i];
+                const uint8_t *cycle = this->Cycle(element);
+                int length = this->CycleLength(element);
+
+                writer.AppendNumber(cycle[0]);
+                writer.Append(": ", 2);
+
+                for(int j = 0; j < length - 1; j++) {
+                    writer.AppendNumber(cycle[j]);
+                    writer.Append(", ", 2);
                 }
 
-            } while(cycleGroupIter != this->cycles.begin());
-
-            return code.str();
+                writer.AppendNumber(cycle[length - 1]);
+                writer.Append(", 1\n", 4);
+            }
         }
 
-        std::string PrintCyclicSubgroups() {
-            std::stringstream code;
+        std::string GetGraphVizCode() const {
+            TableWriter writer;
+            this->WriteGraphVizCode(writer);
 
-            for(const auto &cycleGroup : this->cycles) {
-                /*
-                    Progress from the shortest cycles to the longest.
-                */
-                for(const auto &cycle : *cycleGroup.second) {
-                    for(auto iter = cycle.begin(); iter != cycle.end(); iter++) {
-                        if (iter == cycle.begin()) {
-                            code << *iter << ": ";
-                        }
+            return writer.ToString();
+        }
 
-                        if (std::next(iter) == cycle.end()) {
-                            code << *iter << ", 1\n";
-                        } else {
-                            code << *iter << ", ";
-                        }
-                    }
-                }
+        std::string GetCsAcademyCode() const {
+            TableWriter writer;
+            this->WriteCsAcademyCode(writer);
 
-            }
+            return writer.ToString();
+        }
+
+        std::string PrintCyclicSubgroups() const {
+            TableWriter writer;
+            this->WriteCyclicSubgroups(writer);
 
-            return code.str();
+            return writer.ToString();
         }
 };
@@ -0,0 +1,140 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Keeps the engines of finished searches, and hands them out
+ * again instead of constructing new ones. A returned engine is Reset(),
+ * so it is in the same state as a new one (with the options set by
+ * the factory). The pool can be used from multiple threads.
+ *
+ * Engine: a search engine with a Reset() method. (For example
+ * AssocHeuristics, RandomHeuristics or LatinHeuristics.)
+ */
+template<typename Engine>
+class EnginePool {
+    public:
+        typedef std::function<Engine*(int order)> Factory;
+
+        /**
+         * @brief Holds an engine of the pool until the end of its scope.
+         */
+        class Lease {
+            private:
+                EnginePool &pool;
+                int order;
+                Engine *engine;
+
+            public:
+                Lease(EnginePool &pool, int order) : pool(pool), order(order), engine(pool.Acquire(order)) { }
+
+                ~Lease() {
+                    this->pool.Release(this->engine, this->order);
+                }
+
+                Lease(const Lease &) = delete;
+                Lease& operator=(const Lease &) = delete;
+
+                Engine* operator->() {
+                    return this->engine;
+                }
+
+                Engine& operator*() {
+                    return *this->engine;
+                }
+        };
+
+    private:
+        struct Idle {
+            int order;
+            Engine *engine;
+        };
+
+        Factory factory;
+        std::vector<Idle> idle;
+        std::mutex mutex;
+        int created;
+        int reused;
+
+    public:
+        /**
+         * @param factory Constructs the engines and sets their options.
+         */
+        EnginePool(const Factory &factory) : factory(factory), created(0), reused(0) { }
+
+        /**
+         * @brief The engines are constructed with "new Engine(order)".
+         */
+        EnginePool() : EnginePool([](int order) { return new Engine(order); }) { }
+
+        ~EnginePool() {
+            for(const Idle &item : this->idle) {
+                delete item.engine;
+            }
+        }
+
+        EnginePool(const EnginePool &) = delete;
+        EnginePool& operator=(const EnginePool &) = delete;
+
+        /**
+         * @brief An idle engine of the given order, or a new one.
+         * Give it back with Release(). (Or use a Lease.)
+         */
+        Engine* Acquire(int order) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+
+                for(size_t i = this->idle.size(); i-- > 0; ) {
+                    if (this->idle[i].order == order) {
+                        Engine *engine = this->idle[i].engine;
+                        this->idle.erase(this->idle.begin() + i);
+                        this->reused++;
+
+                        return engine;
+                    }
+                }
+
+                this->created++;
+            }
+
+            return this->factory(order);
+        }
+
+        /**
+         * @brief Resets the engine and keeps it for the next Acquire()
+         * with the same order.
+         */
+        void Release(Engine *engine, int order) {
+            engine->Reset();
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->idle.push_back({ order, engine });
+        }
+
+        int GetCreatedCount() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->created;
+        }
+
+        int GetReusedCount() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->reused;
+        }
+};
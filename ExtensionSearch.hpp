@@ -0,0 +1,410 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include "Automorphisms.hpp"
+
+/**
+ * @brief Builds the groups G with a normal subgroup N and G/N = Q, from
+ * the tables of N and Q, by searching only over the extension data:
+ *  - The action: an automorphism p(x) of N for each x in Q.
+ *  - The factor set: an element f(x, y) of N for each pair in Q.
+ *
+ * The elements of G are the pairs (a, x), with the product
+ *      (a, x) * (b, y) = (a * p(x)(b) * f(x, y), x * y)
+ *
+ * This is a group exactly if, for all x, y, z in Q:
+ *  (A) p(x) p(y) = i(f(x, y)) p(x * y)    (i(m): conjugation by m)
+ *  (B) f(x, y) f(x * y, z) = p(x)(f(y, z)) f(x, y * z)    (cocycle)
+ *
+ * With p(1) = identity and f(1, y) = f(x, 1) = 1 (normalized data),
+ * (1, 1) is the identity of G. The actions are searched first, and (A)
+ * is checked as soon as the 3 actions in it are known: p(x) p(y) p(xy)^-1
+ * must be an inner automorphism. Then for each f(x, y), the candidates
+ * are the elements m with i(m) = p(x) p(y) p(xy)^-1: a bitmask (a coset
+ * of the center), looked up by the automorphism. (B) is checked when its
+ * last factor is set.
+ *
+ * Element (a, x) is x * |N| + a in G (0-based), so the first |N|
+ * elements form N. Different extension data give different tables, but
+ * many of them are isomorphic.
+ */
+class ExtensionSearch {
+    private:
+        int normalOrder;
+        int quotientOrder;
+        int order;
+        std::vector<uint8_t> normal;          // 0-based tables
+        std::vector<uint8_t> quotient;
+        std::vector<std::vector<uint8_t>> automorphisms;
+        std::vector<std::vector<uint8_t>> inverses;
+        std::map<std::vector<uint8_t>, uint64_t> innerMasks;    // Inner automorphism -> elements inducing it
+        std::vector<int> action;              // Automorphism index of each element of Q
+        std::vector<int> factor;              // [x * quotientOrder + y]
+        std::vector<std::vector<std::pair<int, int>>> actionChecks;     // (A) pairs checked per action variable
+        std::vector<std::vector<int>> cocycleChecks;                    // (B) triples checked per factor variable
+        std::vector<uint64_t> candidates;     // Remaining values of the factor variables.
+        std::vector<uint8_t> cayley;
+        std::vector<uint8_t> composition;
+        int actionCount;
+        int variableCount;
+        int depth;
+        bool started;
+        bool found;
+        uint64_t nodes;
+
+        inline int MultN(int a, int b) const {
+            return this->normal[a * this->normalOrder + b];
+        }
+
+        inline int MultQ(int x, int y) const {
+            return this->quotient[x * this->quotientOrder + y];
+        }
+
+        inline int Factor(int x, int y) const {
+            return this->factor[x * this->quotientOrder + y];
+        }
+
+        /**
+         * @brief All automorphisms of N, from the generators of Automorphisms.
+         */
+        void EnumerateAutomorphisms(const uint8_t *normalTable) {
+            int n = this->normalOrder;
+            Automorphisms aut(n, normalTable);
+
+            if (aut.GetOrder() > 200000) {
+                throw std::runtime_error("ExtensionSearch: Aut(N) is too large: " + std::to_string(aut.GetOrder()));
+            }
+
+            std::vector<std::vector<uint8_t>> generators;
+
+            for(const std::vector<uint8_t> &generator : aut.GetGenerators()) {
+                std::vector<uint8_t> images(n);
+
+                for(int i = 0; i < n; i++) {
+                    images[i] = generator[i] - 1;
+                }
+
+                generators.push_back(images);
+            }
+
+            std::vector<uint8_t> identity(n);
+
+            for(int i = 0; i < n; i++) {
+                identity[i] = i;
+            }
+
+            std::set<std::vector<uint8_t>> seen;
+            seen.insert(identity);
+            this->automorphisms.push_back(identity);
+
+            for(size_t k = 0; k < this->automorphisms.size(); k++) {
+                for(const std::vector<uint8_t> &generator : generators) {
+                    std::vector<uint8_t> product(n);
+
+                    for(int i = 0; i < n; i++) {
+                        product[i] = generator[this->automorphisms[k][i]];
+                    }
+
+                    if (seen.insert(product).second) {
+                        this->automorphisms.push_back(product);
+                    }
+                }
+            }
+
+            for(const std::vector<uint8_t> &automorphism : this->automorphisms) {
+                std::vector<uint8_t> inverse(n);
+
+                for(int i = 0; i < n; i++) {
+                    inverse[automorphism[i]] = i;
+                }
+
+                this->inverses.push_back(inverse);
+            }
+
+            /*
+                Inner automorphisms: c -> m c m^-1
+            */
+            for(int m = 0; m < n; m++) {
+                int inverse = 0;
+
+                while(this->MultN(m, inverse) != 0) {
+                    inverse++;
+                }
+
+                std::vector<uint8_t> conjugation(n);
+
+                for(int c = 0; c < n; c++) {
+                    conjugation[c] = this->MultN(this->MultN(m, c), inverse);
+                }
+
+                this->innerMasks[conjugation] |= ((uint64_t)1) << m;
+            }
+        }
+
+        /**
+         * @brief Elements m with i(m) = p(x) p(y) p(xy)^-1 (0 if it's not inner).
+         */
+        uint64_t InnerMask(int x, int y) {
+            int n = this->normalOrder;
+            const std::vector<uint8_t> &px = this->automorphisms[this->action[x]];
+            const std::vector<uint8_t> &py = this->automorphisms[this->action[y]];
+            const std::vector<uint8_t> &pxyInverse = this->inverses[this->action[this->MultQ(x, y)]];
+
+            for(int c = 0; c < n; c++) {
+                this->composition[c] = px[py[pxyInverse[c]]];
+            }
+
+            auto it = this->innerMasks.find(this->composition);
+
+            return it == this->innerMasks.end() ? 0 : it->second;
+        }
+
+        bool CheckCocycle(int triple) const {
+            int q = this->quotientOrder;
+            int x = triple / (q * q);
+            int y = (triple / q) % q;
+            int z = triple % q;
+            int xy = this->MultQ(x, y);
+            int yz = this->MultQ(y, z);
+
+            int left = this->MultN(this->Factor(x, y), this->Factor(xy, z));
+            int right = this->MultN(this->automorphisms[this->action[x]][this->Factor(y, z)], this->Factor(x, yz));
+
+            return left == right;
+        }
+
+        /**
+         * @brief Which variable is the last one of each condition.
+         */
+        void PlanChecks() {
+            int q = this->quotientOrder;
+            this->actionChecks.resize(q);
+            this->cocycleChecks.resize(this->variableCount);
+
+            for(int x = 1; x < q; x++) {
+                for(int y = 1; y < q; y++) {
+                    int last = std::max(std::max(x, y), this->MultQ(x, y));
+                    this->actionChecks[last].push_back(std::make_pair(x, y));
+                }
+            }
+
+            for(int x = 1; x < q; x++) {
+                for(int y = 1; y < q; y++) {
+                    for(int z = 1; z < q; z++) {
+                        int xy = this->MultQ(x, y);
+                        int yz = this->MultQ(y, z);
+                        int last = std::max(this->FactorVariable(x, y), this->FactorVariable(y, z));
+
+                        last = std::max(last, xy == 0 ? -1 : this->FactorVariable(xy, z));
+                        last = std::max(last, yz == 0 ? -1 : this->FactorVariable(x, yz));
+                        this->cocycleChecks[last].push_back((x * q + y) * q + z);
+                    }
+                }
+            }
+        }
+
+        inline int FactorVariable(int x, int y) const {
+            return this->actionCount + (x - 1) * (this->quotientOrder - 1) + (y - 1);
+        }
+
+        /**
+         * @brief Prepares the candidates of the variable at "depth".
+         */
+        void EnterVariable() {
+            if (this->depth >= this->variableCount) {
+                return;
+            }
+
+            if (this->depth < this->actionCount) {
+                this->action[this->depth + 1] = -1;
+                return;
+            }
+
+            int index = this->depth - this->actionCount;
+            int x = index / (this->quotientOrder - 1) + 1;
+            int y = index % (this->quotientOrder - 1) + 1;
+            this->candidates[this->depth] = this->InnerMask(x, y);
+        }
+
+        /**
+         * @brief Sets the next candidate of the variable at "depth".
+         * @return False if there are no more.
+         */
+        bool NextValue() {
+            if (this->depth < this->actionCount) {
+                int x = this->depth + 1;
+
+                while(++this->action[x] < (int)this->automorphisms.size()) {
+                    this->nodes++;
+                    bool valid = true;
+
+                    for(const std::pair<int, int> &pair : this->actionChecks[x]) {
+                        if (this->InnerMask(pair.first, pair.second) == 0) {
+                            valid = false;
+                            break;
+                        }
+                    }
+
+                    if (valid) {
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            uint64_t &mask = this->candidates[this->depth];
+            int index = this->depth - this->actionCount;
+            int x = index / (this->quotientOrder - 1) + 1;
+            int y = index % (this->quotientOrder - 1) + 1;
+
+            while(mask != 0) {
+                int m = __builtin_ctzll(mask);
+                mask &= mask - 1;
+                this->factor[x * this->quotientOrder + y] = m;
+                this->nodes++;
+                bool valid = true;
+
+                for(int triple : this->cocycleChecks[this->depth]) {
+                    if (!this->CheckCocycle(triple)) {
+                        valid = false;
+                        break;
+                    }
+                }
+
+                if (valid) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void BuildTable() {
+            int n = this->normalOrder;
+            int q = this->quotientOrder;
+
+            for(int x = 0; x < q; x++) {
+                for(int a = 0; a < n; a++) {
+                    for(int y = 0; y < q; y++) {
+                        for(int b = 0; b < n; b++) {
+                            int value = this->MultN(this->MultN(a, this->automorphisms[this->action[x]][b]),
+                                this->Factor(x, y));
+
+                            this->cayley[(x * n + a) * this->order + y * n + b] = this->MultQ(x, y) * n + value + 1;
+                        }
+                    }
+                }
+            }
+        }
+
+    public:
+        /**
+         * @param normalTable, quotientTable Group tables with 1-based values
+         * (the format of the other modules), the identity is 1.
+         */
+        ExtensionSearch(int normalOrder, const uint8_t *normalTable, int quotientOrder, const uint8_t *quotientTable)
+            : normalOrder(normalOrder), quotientOrder(quotientOrder), order(normalOrder * quotientOrder),
+              depth(0), started(false), found(false), nodes(0) {
+
+            if (normalOrder < 1 || normalOrder > 64 || quotientOrder < 1 || this->order > 255) {
+                throw std::runtime_error("ExtensionSearch: |N| must be 1 -> 64 and |N| * |Q| at most 255.");
+            }
+
+            this->normal.resize(normalOrder * normalOrder);
+            this->quotient.resize(quotientOrder * quotientOrder);
+
+            for(int i = 0; i < normalOrder * normalOrder; i++) {
+                this->normal[i] = normalTable[i] - 1;
+            }
+
+            for(int i = 0; i < quotientOrder * quotientOrder; i++) {
+                this->quotient[i] = quotientTable[i] - 1;
+            }
+
+            this->composition.resize(normalOrder);
+            this->cayley.resize(this->order * this->order);
+            this->EnumerateAutomorphisms(normalTable);
+
+            this->actionCount = quotientOrder - 1;
+            this->variableCount = this->actionCount + (quotientOrder - 1) * (quotientOrder - 1);
+            this->action.assign(quotientOrder, 0);
+            this->factor.assign(quotientOrder * quotientOrder, 0);
+            this->candidates.assign(this->variableCount + 1, 0);
+            this->PlanChecks();
+        }
+
+        /**
+         * @brief Finds the next extension.
+         * @return False if there are no more. (Check Found() too.)
+         */
+        bool Next() {
+            this->found = false;
+
+            if (!this->started) {
+                this->started = true;
+                this->depth = 0;
+                this->EnterVariable();
+            } else {
+                this->depth--;
+            }
+
+            while(true) {
+                if (this->depth == this->variableCount) {
+                    this->BuildTable();
+                    this->found = true;
+                    return true;
+                }
+
+                if (this->depth < 0) {
+                    return false;
+                }
+
+                if (this->NextValue()) {
+                    this->depth++;
+                    this->EnterVariable();
+                } else {
+                    this->depth--;
+                }
+            }
+        }
+
+        bool Found() {
+            return this->found;
+        }
+
+        uint8_t* GetCayley() {
+            return &this->cayley[0];
+        }
+
+        uint64_t GetNodeCount() {
+            return this->nodes;
+        }
+
+        /**
+         * @brief |Aut(N)|, the number of choices of each action.
+         */
+        int GetAutomorphismCount() {
+            return this->automorphisms.size();
+        }
+};
@@ -0,0 +1,441 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "GroupExplorer.h"
+#include "AssocHeuristics.hpp"
+#include "LatinHeuristics.hpp"
+#include "RandomHeuristics.hpp"
+#include "BatchAnalyzer.hpp"
+#include "Classifier.hpp"
+#include "CycleGraph.hpp"
+#include "SearchBudget.hpp"
+#include "TableWriter.hpp"
+
+/**
+ * @brief The handle of the C interface: one of the engines, and the
+ * cancellation flag of its budgets.
+ */
+struct ge_engine {
+    int kind;
+    int order;
+    std::unique_ptr<AssocHeuristics> assoc;
+    std::unique_ptr<LatinHeuristics> latin;
+    std::unique_ptr<RandomHeuristics> random;
+    std::atomic<bool> cancel;
+};
+
+namespace {
+    thread_local std::string lastError;
+
+    /*
+        Per thread working memory of the table functions.
+    */
+    thread_local CycleGraph graph;
+    thread_local TableWriter writer;
+
+    int Fail(const std::string &message) {
+        lastError = message;
+        return GE_ERROR;
+    }
+
+    /**
+     * @brief Runs the body of an interface function: the exceptions
+     * are converted to GE_ERROR.
+     */
+    template<typename Body>
+    int Guard(Body body) {
+        try {
+            lastError.clear();
+            return body();
+        }
+        catch (const std::exception &e) {
+            return Fail(e.what());
+        }
+        catch (...) {
+            return Fail("Unknown error.");
+        }
+    }
+
+    void CheckEngine(const ge_engine *engine) {
+        if (engine == nullptr) {
+            throw std::runtime_error("The engine is NULL.");
+        }
+    }
+
+    void CheckAssoc(const ge_engine *engine, const char *function) {
+        CheckEngine(engine);
+
+        if (engine->kind != GE_ENGINE_ASSOC) {
+            throw std::runtime_error(std::string(function) + " is only supported by GE_ENGINE_ASSOC.");
+        }
+    }
+
+    /**
+     * @brief The values must be elements, so the queries can't index
+     * out of the table.
+     */
+    void CheckTable(int order, const uint8_t *table) {
+        if (order < 1 || order > 255) {
+            throw std::runtime_error("Invalid order value. Allowed: 1 -> 255");
+        }
+
+        if (table == nullptr) {
+            throw std::runtime_error("The table is NULL.");
+        }
+
+        for(int i = 0; i < order * order; i++) {
+            if (table[i] < 1 || table[i] > order) {
+                throw std::runtime_error("Invalid table: bad value at row " + std::to_string(i / order + 1)
+                    + ", column " + std::to_string(i % order + 1) + ".");
+            }
+        }
+    }
+
+    /**
+     * @brief The Classifier only reads the table.
+     */
+    uint8_t* Writable(const uint8_t *table) {
+        return const_cast<uint8_t*>(table);
+    }
+
+    int ToInt(int64_t value) {
+        if (value < INT32_MIN || value > INT32_MAX) {
+            throw std::runtime_error("The option value is out of range.");
+        }
+
+        return (int)value;
+    }
+
+    int ToStatus(SearchStatus status) {
+        switch(status) {
+            case SearchStatus::Found:
+                return GE_FOUND;
+            case SearchStatus::Finished:
+                return GE_FINISHED;
+            default:
+                return GE_BUDGET_EXHAUSTED;
+        }
+    }
+}
+
+extern "C" {
+
+GE_API int ge_abi_version(void) {
+    return GE_ABI_VERSION;
+}
+
+GE_API const char* ge_last_error(void) {
+    return lastError.c_str();
+}
+
+GE_API ge_engine* ge_engine_create(int kind, int order, uint32_t seed) {
+    std::unique_ptr<ge_engine> engine(new (std::nothrow) ge_engine());
+
+    if (engine == nullptr) {
+        Fail("Out of memory.");
+        return nullptr;
+    }
+
+    int status = Guard([&]() {
+        /*
+            The engines take the order as uint8_t.
+        */
+        if (order < 2 || order > 31) {
+            throw std::runtime_error("Invalid order value. Allowed: 2 -> 31");
+        }
+
+        engine->kind = kind;
+        engine->order = order;
+        engine->cancel = false;
+
+        switch(kind) {
+            case GE_ENGINE_ASSOC:
+                engine->assoc.reset(new AssocHeuristics(order));
+                break;
+            case GE_ENGINE_LATIN:
+                engine->latin.reset(new LatinHeuristics(order));
+                break;
+            case GE_ENGINE_RANDOM:
+                engine->random.reset(new RandomHeuristics(order, seed));
+                break;
+            default:
+                throw std::runtime_error("Unknown engine kind: " + std::to_string(kind));
+        }
+
+        return GE_OK;
+    });
+
+    return status == GE_OK ? engine.release() : nullptr;
+}
+
+GE_API void ge_engine_destroy(ge_engine *engine) {
+    delete engine;
+}
+
+GE_API int ge_engine_reset(ge_engine *engine) {
+    return Guard([&]() {
+        CheckEngine(engine);
+
+        switch(engine->kind) {
+            case GE_ENGINE_ASSOC:
+                engine->assoc->Reset();
+                break;
+            case GE_ENGINE_LATIN:
+                engine->latin->Reset();
+                break;
+            default:
+                engine->random->Reset();
+                break;
+        }
+
+        return GE_OK;
+    });
+}
+
+GE_API int ge_engine_set_option(ge_engine *engine, int option, int64_t value) {
+    return Guard([&]() {
+        CheckEngine(engine);
+
+        if (option == GE_OPTION_ALL_DIFFERENT && engine->kind == GE_ENGINE_LATIN) {
+            engine->latin->SetAllDifferent(value != 0);
+            return GE_OK;
+        }
+
+        CheckAssoc(engine, "ge_engine_set_option");
+        AssocHeuristics &assoc = *engine->assoc;
+
+        switch(option) {
+            case GE_OPTION_ABELIAN:
+                assoc.SetAbelian(value != 0);
+                break;
+            case GE_OPTION_BACKJUMPING:
+                assoc.SetBackjumping(value != 0);
+                break;
+            case GE_OPTION_NOGOODS:
+                assoc.SetNogoodLearning(ToInt(value));
+                break;
+            case GE_OPTION_ALL_DIFFERENT:
+                assoc.SetAllDifferent(value != 0);
+                break;
+            case GE_OPTION_ELEMENT_ORDERS:
+                assoc.SetElementOrderPruning(value != 0);
+                break;
+            case GE_OPTION_DEPTH_LIMIT:
+                assoc.SetDepthLimit(ToInt(value));
+                break;
+            default:
+                throw std::runtime_error("Unknown option: " + std::to_string(option));
+        }
+
+        return GE_OK;
+    });
+}
+
+GE_API int ge_engine_load_prefix(ge_engine *engine, const uint8_t *prefix, int depth) {
+    return Guard([&]() {
+        CheckAssoc(engine, "ge_engine_load_prefix");
+
+        if (prefix == nullptr) {
+            throw std::runtime_error("The prefix is NULL.");
+        }
+
+        engine->assoc->LoadPrefix(prefix, depth);
+
+        return GE_OK;
+    });
+}
+
+GE_API int ge_engine_next(ge_engine *engine, uint64_t node_limit, double seconds) {
+    return Guard([&]() {
+        CheckEngine(engine);
+
+        SearchBudget budget;
+        budget.SetNodeLimit(node_limit);
+        budget.SetCancelFlag(&engine->cancel);
+
+        if (seconds > 0) {
+            budget.SetTimeLimit(seconds);
+        }
+
+        SearchStatus status;
+
+        switch(engine->kind) {
+            case GE_ENGINE_ASSOC:
+                status = engine->assoc->Next(budget);
+                break;
+            case GE_ENGINE_LATIN:
+                status = engine->latin->Next(budget);
+                break;
+            default:
+                status = engine->random->Next(budget);
+                break;
+        }
+
+        /*
+            A cancellation stops only one call.
+        */
+        if (status == SearchStatus::BudgetExhausted && budget.IsCancelled()) {
+            engine->cancel = false;
+        }
+
+        return ToStatus(status);
+    });
+}
+
+GE_API void ge_engine_cancel(ge_engine *engine) {
+    if (engine != nullptr) {
+        engine->cancel = true;
+    }
+}
+
+GE_API const uint8_t* ge_engine_table(const ge_engine *engine, int *order) {
+    if (engine == nullptr) {
+        Fail("The engine is NULL.");
+        return nullptr;
+    }
+
+    if (order != nullptr) {
+        *order = engine->order;
+    }
+
+    switch(engine->kind) {
+        case GE_ENGINE_ASSOC:
+            return engine->assoc->GetCayley();
+        case GE_ENGINE_LATIN:
+            return engine->latin->GetCayley();
+        default:
+            return engine->random->GetCayley();
+    }
+}
+
+GE_API int ge_table_properties(int order, const uint8_t *table, ge_properties *properties) {
+    return Guard([&]() {
+        CheckTable(order, table);
+
+        if (properties == nullptr) {
+            throw std::runtime_error("The properties are NULL.");
+        }
+
+        TableProperties result;
+        BatchAnalyzer::Analyze(order, Writable(table), graph, result);
+
+        properties->flags = result.flags;
+        properties->subgroups = result.subgroups;
+        properties->normal_subgroups = result.normalSubgroups;
+        properties->cyclic_subgroups = result.cyclicSubgroups;
+        properties->maximal_cyclic = result.maximalCyclic;
+
+        return GE_OK;
+    });
+}
+
+GE_API int ge_table_element_orders(int order, const uint8_t *table, uint8_t *orders) {
+    return Guard([&]() {
+        CheckTable(order, table);
+
+        if (orders == nullptr) {
+            throw std::runtime_error("The output array is NULL.");
+        }
+
+        graph.Build(order, table);
+
+        for(int e = 1; e <= order; e++) {
+            orders[e - 1] = graph.GetElementOrder(e);
+        }
+
+        return GE_OK;
+    });
+}
+
+GE_API int ge_table_maximal_cycles(int order, const uint8_t *table, uint8_t *generators, size_t *count) {
+    return Guard([&]() {
+        CheckTable(order, table);
+
+        if (count == nullptr || (generators == nullptr && *count > 0)) {
+            throw std::runtime_error("The output array is NULL.");
+        }
+
+        graph.Build(order, table);
+        const std::vector<uint8_t> &maximal = graph.GetMaximalCycles();
+        size_t capacity = *count;
+        *count = maximal.size();
+
+        if (capacity < maximal.size()) {
+            return GE_ERROR_BUFFER;
+        }
+
+        if (!maximal.empty()) {
+            memcpy(generators, &maximal[0], maximal.size());
+        }
+
+        return GE_OK;
+    });
+}
+
+GE_API int ge_table_format(int order, const uint8_t *table, int format, char *buffer, size_t *size) {
+    return Guard([&]() {
+        CheckTable(order, table);
+
+        if (size == nullptr || (buffer == nullptr && *size > 0)) {
+            throw std::runtime_error("The buffer is NULL.");
+        }
+
+        writer.Clear();
+
+        switch(format) {
+            case GE_FORMAT_TABLE:
+                writer.WriteTable(order, table);
+                break;
+            case GE_FORMAT_MARKDOWN:
+                Classifier(order, Writable(table)).WriteGroup(writer);
+                break;
+            case GE_FORMAT_GRAPHVIZ:
+                graph.Build(order, table);
+                graph.WriteGraphVizCode(writer);
+                break;
+            case GE_FORMAT_CSACADEMY:
+                graph.Build(order, table);
+                graph.WriteCsAcademyCode(writer);
+                break;
+            case GE_FORMAT_CYCLIC_SUBGROUPS:
+                graph.Build(order, table);
+                graph.WriteCyclicSubgroups(writer);
+                break;
+            default:
+                throw std::runtime_error("Unknown format: " + std::to_string(format));
+        }
+
+        size_t capacity = *size;
+
+        if (capacity < writer.GetSize() + 1) {
+            *size = writer.GetSize() + 1;
+            return GE_ERROR_BUFFER;
+        }
+
+        memcpy(buffer, writer.GetData(), writer.GetSize());
+        buffer[writer.GetSize()] = '\0';
+        *size = writer.GetSize();
+
+        return GE_OK;
+    });
+}
+
+}
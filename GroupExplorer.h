@@ -0,0 +1,169 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#ifndef GROUP_EXPLORER_H
+#define GROUP_EXPLORER_H
+
+/*
+    C interface of the shared library (make lib -> libgroup.so).
+
+    Tables: n * n bytes in row-major order, the elements are 1 -> n and
+    1 is the identity (the format of the search engines). The functions
+    only read the tables of the caller, and never keep a pointer to them.
+
+    Errors: the functions return a negative status, and ge_last_error()
+    describes the last error of the calling thread. No C++ exception
+    leaves the library.
+
+    Threads: an engine can be used by one thread at a time, except
+    ge_engine_cancel(), which can be called from any thread. The table
+    functions can be called from any number of threads.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #define GE_API __declspec(dllexport)
+#else
+    #define GE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented on each incompatible change of the interface. */
+#define GE_ABI_VERSION 1
+
+/* Status codes */
+#define GE_OK                   0
+#define GE_FOUND                1   /* ge_engine_next(): a table was found. */
+#define GE_FINISHED             2   /* ge_engine_next(): the whole tree was searched. */
+#define GE_BUDGET_EXHAUSTED     3   /* ge_engine_next(): stopped by the budget or ge_engine_cancel(). */
+#define GE_ERROR               -1   /* Invalid argument or internal error. (See ge_last_error().) */
+#define GE_ERROR_BUFFER        -2   /* The buffer is too small. The required size is returned. */
+
+/* Engines */
+#define GE_ENGINE_ASSOC         1   /* AssocHeuristics: groups. */
+#define GE_ENGINE_LATIN         2   /* LatinHeuristics: reduced Latin squares. */
+#define GE_ENGINE_RANDOM        3   /* RandomHeuristics: groups, randomized. */
+
+/* Engine options (ge_engine_set_option) */
+#define GE_OPTION_ABELIAN           1   /* ASSOC. 0/1. Resets the search and drops the learnt nogoods. */
+#define GE_OPTION_BACKJUMPING       2   /* ASSOC. 0/1 */
+#define GE_OPTION_NOGOODS           3   /* ASSOC. Capacity of the nogood cache. (0: disabled) */
+#define GE_OPTION_ALL_DIFFERENT     4   /* ASSOC, LATIN. 0/1 */
+#define GE_OPTION_ELEMENT_ORDERS    5   /* ASSOC. 0/1 */
+#define GE_OPTION_DEPTH_LIMIT       6   /* ASSOC. Number of free cells, the results are prefixes. */
+
+/* Property flags (ge_properties.flags) */
+#define GE_ASSOCIATIVE          1
+#define GE_ABELIAN              2
+#define GE_CYCLIC               4
+#define GE_SIMPLE               8
+#define GE_DEDEKIND            16
+#define GE_HAMILTONIAN         32
+
+/* Text formats (ge_table_format) */
+#define GE_FORMAT_TABLE             1   /* The format of the table files. (Semicolon separated) */
+#define GE_FORMAT_MARKDOWN          2   /* Markdown table. */
+#define GE_FORMAT_GRAPHVIZ          3   /* Graphviz code of the cycle graph. */
+#define GE_FORMAT_CSACADEMY         4   /* CsAcademy code of the cycle graph. */
+#define GE_FORMAT_CYCLIC_SUBGROUPS  5   /* The cycle of each element. */
+
+typedef struct ge_engine ge_engine;
+
+/*
+    The meaning of the fields is the same as in the analyze command.
+    The subgroup counts are proper and non-trivial. A table which is
+    not associative only has the GE_ABELIAN flag.
+*/
+typedef struct ge_properties {
+    uint32_t flags;
+    uint32_t subgroups;
+    uint32_t normal_subgroups;
+    uint32_t cyclic_subgroups;      /* Non-trivial */
+    uint32_t maximal_cyclic;        /* Number of cycles in the cycle graph. */
+} ge_properties;
+
+GE_API int ge_abi_version(void);
+
+/* The message of the last error in the calling thread. ("" if none) */
+GE_API const char* ge_last_error(void);
+
+/*
+    Engines
+*/
+
+/* Returns NULL on error. The seed is only used by GE_ENGINE_RANDOM. */
+GE_API ge_engine* ge_engine_create(int kind, int order, uint32_t seed);
+GE_API void ge_engine_destroy(ge_engine *engine);
+
+/* Restart the search from the beginning. The options are kept, except the depth limit. */
+GE_API int ge_engine_reset(ge_engine *engine);
+GE_API int ge_engine_set_option(ge_engine *engine, int option, int64_t value);
+
+/* GE_ENGINE_ASSOC: search only the subtree of a prefix produced with a depth limit. */
+GE_API int ge_engine_load_prefix(ge_engine *engine, const uint8_t *prefix, int depth);
+
+/*
+    Searches for the next table. node_limit: maximal number of nodes
+    (0: no limit). seconds: time limit (0: no limit). After
+    GE_BUDGET_EXHAUSTED the next call continues from the same point.
+*/
+GE_API int ge_engine_next(ge_engine *engine, uint64_t node_limit, double seconds);
+
+/*
+    Stops the running ge_engine_next() call of the engine. If none is
+    running, the next call returns GE_BUDGET_EXHAUSTED immediately.
+*/
+GE_API void ge_engine_cancel(ge_engine *engine);
+
+/*
+    Borrowed view of the current table of the engine (order * order
+    bytes, valid until the next call on the engine). The order is
+    written to "order" if it is not NULL.
+*/
+GE_API const uint8_t* ge_engine_table(const ge_engine *engine, int *order);
+
+/*
+    Tables (orders 1 -> 255)
+*/
+
+GE_API int ge_table_properties(int order, const uint8_t *table, ge_properties *properties);
+
+/* Writes the order of each element into orders[0 .. order - 1]. */
+GE_API int ge_table_element_orders(int order, const uint8_t *table, uint8_t *orders);
+
+/*
+    The generators of the maximal cyclic subgroups, from the longest
+    cycle to the shortest. count: the capacity of "generators" on input,
+    the number of generators on output (also on GE_ERROR_BUFFER).
+*/
+GE_API int ge_table_maximal_cycles(int order, const uint8_t *table, uint8_t *generators, size_t *count);
+
+/*
+    Writes the text into the buffer, with a terminating zero. size: the
+    capacity of the buffer on input, the length of the text on output
+    (without the zero). On GE_ERROR_BUFFER the required capacity.
+*/
+GE_API int ge_table_format(int order, const uint8_t *table, int format, char *buffer, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
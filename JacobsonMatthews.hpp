@@ -0,0 +1,308 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <random>
+#include <stdexcept>
+
+/**
+ * @brief Random Latin squares with the Markov chain of Jacobson and
+ * Matthews. Its stationary distribution is uniform on the Latin squares,
+ * so after enough steps the squares are approximately uniformly random.
+ * (Unlike RandomHeuristics, which is biased and slow above order 10.)
+ *
+ * A square is a 0/1 incidence cube: (row, column, symbol) = 1 if the
+ * cell has the symbol. A step picks a 0 point (r, c, s) and the points
+ * r', c', s' which complete it to a 2x2x2 subcube: adds 1 to (r,c,s),
+ * (r,c',s'), (r',c,s'), (r',c',s) and subtracts 1 from the other four.
+ * If (r',c',s') was 0, it becomes -1, and the cube is "improper": the
+ * lines through that point have two 1s each. The next step starts from
+ * the -1 point and picks r', c', s' randomly from the two choices, until
+ * the cube is proper again.
+ *
+ * The cube is stored as three tables (symbol of each cell, column of
+ * each symbol in the rows, row of each symbol in the columns), plus the
+ * second entries of the three doubled lines of the improper point.
+ * A step is O(1).
+ */
+class JacobsonMatthews {
+    private:
+        int order;
+        std::vector<uint8_t> cellSymbol;      // [row * order + column]
+        std::vector<uint8_t> rowColumn;       // [row * order + symbol]
+        std::vector<uint8_t> columnRow;       // [column * order + symbol]
+        std::vector<uint8_t> cayley;
+        std::mt19937_64 random;
+
+        /*
+            The -1 point of an improper cube, and the second 1s on its lines.
+        */
+        bool improper;
+        int improperRow;
+        int improperColumn;
+        int improperSymbol;
+        int extraSymbol;        // The second symbol of the improper cell.
+        int extraColumn;        // The second column of the improper symbol in the improper row.
+        int extraRow;           // The second row of the improper symbol in the improper column.
+        uint64_t steps;
+
+        inline int Random(int limit) {
+            return std::uniform_int_distribution<int>(0, limit - 1)(this->random);
+        }
+
+        /**
+         * @brief The changes of the 2x2x2 subcube outside the lines of the starting point (r, c, s).
+         * Cell (r1, c1) gets s and loses s1. Returns the new state of the cube.
+         */
+        void FinishMove(int r, int c, int r1, int c1, int s, int s1) {
+            int n = this->order;
+            int held = this->cellSymbol[r1 * n + c1];
+
+            if (held == s1) {
+                this->cellSymbol[r1 * n + c1] = s;
+                this->rowColumn[r1 * n + s1] = c;
+                this->rowColumn[r1 * n + s] = c1;
+                this->columnRow[c1 * n + s1] = r;
+                this->columnRow[c1 * n + s] = r1;
+                this->improper = false;
+
+                return;
+            }
+
+            /*
+                (r1, c1, s1) becomes -1. The cell keeps its symbol and
+                gets s. Symbol s1 stays in row r1 at its old column and
+                in column c1 at its old row, and gets c and r as the
+                second entries.
+            */
+            this->rowColumn[r1 * n + s] = c1;
+            this->columnRow[c1 * n + s] = r1;
+            this->improper = true;
+            this->improperRow = r1;
+            this->improperColumn = c1;
+            this->improperSymbol = s1;
+            this->extraSymbol = s;
+            this->extraColumn = c;
+            this->extraRow = r;
+        }
+
+        /**
+         * @brief A step from a proper cube: random point (r, c, s) with s not in the cell.
+         */
+        void ProperStep() {
+            int n = this->order;
+            int r = this->Random(n);
+            int c = this->Random(n);
+            int s1 = this->cellSymbol[r * n + c];
+            int s = this->Random(n - 1);
+
+            if (s >= s1) {
+                s++;
+            }
+
+            int c1 = this->rowColumn[r * n + s];
+            int r1 = this->columnRow[c * n + s];
+
+            this->cellSymbol[r * n + c] = s;
+            this->cellSymbol[r * n + c1] = s1;
+            this->cellSymbol[r1 * n + c] = s1;
+            this->rowColumn[r * n + s] = c;
+            this->rowColumn[r * n + s1] = c1;
+            this->columnRow[c * n + s] = r;
+            this->columnRow[c * n + s1] = r1;
+
+            this->FinishMove(r, c, r1, c1, s, s1);
+        }
+
+        /**
+         * @brief A step from the -1 point (r, c, s): s1, c1 and r1 are
+         * chosen from the two 1s of the lines through it.
+         */
+        void ImproperStep() {
+            int n = this->order;
+            int r = this->improperRow;
+            int c = this->improperColumn;
+            int s = this->improperSymbol;
+            int s1 = this->cellSymbol[r * n + c];
+            int sOther = this->extraSymbol;
+            int c1 = this->rowColumn[r * n + s];
+            int cOther = this->extraColumn;
+            int r1 = this->columnRow[c * n + s];
+            int rOther = this->extraRow;
+
+            if (this->Random(2)) {
+                std::swap(s1, sOther);
+            }
+
+            if (this->Random(2)) {
+                std::swap(c1, cOther);
+            }
+
+            if (this->Random(2)) {
+                std::swap(r1, rOther);
+            }
+
+            /*
+                (r, c) keeps the other symbol, s moves to (r1, c)
+                and (r, c1) from the other entries of the lines.
+            */
+            this->cellSymbol[r * n + c] = sOther;
+            this->cellSymbol[r * n + c1] = s1;
+            this->cellSymbol[r1 * n + c] = s1;
+            this->rowColumn[r * n + s] = cOther;
+            this->rowColumn[r * n + s1] = c1;
+            this->rowColumn[r * n + sOther] = c;
+            this->columnRow[c * n + s] = rOther;
+            this->columnRow[c * n + s1] = r1;
+            this->columnRow[c * n + sOther] = r;
+
+            this->FinishMove(r, c, r1, c1, s, s1);
+        }
+
+    public:
+        /**
+         * @brief Starts from the cyclic table.
+         */
+        JacobsonMatthews(int order, uint64_t seed) : order(order), random(seed), improper(false), steps(0) {
+            if (order < 1 || order > 255) {
+                throw std::runtime_error("Invalid order value. Allowed: 1 -> 255");
+            }
+
+            int n = order;
+            this->cellSymbol.resize(n * n);
+            this->rowColumn.resize(n * n);
+            this->columnRow.resize(n * n);
+            this->cayley.resize(n * n);
+
+            for(int r = 0; r < n; r++) {
+                for(int c = 0; c < n; c++) {
+                    int s = (r + c) % n;
+                    this->cellSymbol[r * n + c] = s;
+                    this->rowColumn[r * n + s] = c;
+                    this->columnRow[c * n + s] = r;
+                }
+            }
+        }
+
+        /**
+         * @brief One step of the chain.
+         */
+        void Step() {
+            if (this->order < 2) {
+                return;
+            }
+
+            if (this->improper) {
+                this->ImproperStep();
+            } else {
+                this->ProperStep();
+            }
+
+            this->steps++;
+        }
+
+        /**
+         * @brief Makes "count" moves between proper squares. (One move
+         * is a step from a proper square, plus the steps of the improper
+         * excursion after it.) 0 means no mixing: the square stays.
+         *
+         * The proper squares visited form a chain with uniform stationary
+         * distribution. Stopping at the first proper square after a fixed
+         * number of steps would be biased: the long improper excursions
+         * lead to some squares more often than to others. (At order 255
+         * only about 1 state in 250 is proper.)
+         */
+        void Mix(uint64_t count) {
+            for(uint64_t i = 0; i < count; i++) {
+                do {
+                    this->Step();
+                } while(this->improper);
+            }
+        }
+
+        /**
+         * @brief The next sample: mixes and copies the square in the
+         * 1-based format of the other modules.
+         *
+         * @param mixingMoves Moves between two samples. (See Mix(). With
+         * 0 the same square is returned again.)
+         * @param reduced Permute the columns and the rows so that the first
+         * row and column are in order. (This keeps the distribution uniform
+         * on the reduced squares.)
+         */
+        uint8_t* Next(uint64_t mixingMoves, bool reduced) {
+            int n = this->order;
+            this->Mix(mixingMoves);
+
+            if (!reduced) {
+                for(int i = 0; i < n * n; i++) {
+                    this->cayley[i] = this->cellSymbol[i] + 1;
+                }
+
+                return &this->cayley[0];
+            }
+
+            /*
+                Symbol of the first row -> its column. Then the rows
+                are ordered by their symbol in the (new) first column.
+            */
+            int firstColumn = this->rowColumn[0];
+
+            for(int r = 0; r < n; r++) {
+                int targetRow = this->cellSymbol[r * n + firstColumn];
+
+                for(int c = 0; c < n; c++) {
+                    int targetColumn = this->cellSymbol[c];
+                    this->cayley[targetRow * n + targetColumn] = this->cellSymbol[r * n + c] + 1;
+                }
+            }
+
+            return &this->cayley[0];
+        }
+
+        bool IsProper() const {
+            return !this->improper;
+        }
+
+        /**
+         * @brief Checks the consistency of the three tables. (For tests, O(n^2).)
+         */
+        bool Verify() const {
+            int n = this->order;
+
+            if (this->improper) {
+                return false;
+            }
+
+            for(int r = 0; r < n; r++) {
+                for(int c = 0; c < n; c++) {
+                    int s = this->cellSymbol[r * n + c];
+
+                    if (this->rowColumn[r * n + s] != c || this->columnRow[c * n + s] != r) {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        uint64_t GetStepCount() const {
+            return this->steps;
+        }
+};
@@ -0,0 +1,303 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "AssocHeuristics.hpp"
+#include "Automorphisms.hpp"
+
+/**
+ * @brief Counts the labelled Cayley tables of the groups of an order
+ * (the identity is 1, the other elements are labelled in every possible
+ * way) with AssocHeuristics::Count(), which only counts at the leaves.
+ * The search is split by the prefixes of the first free row (the row of
+ * element 2), and the threads take them through an atomic counter.
+ *
+ * Check mode: the tables of each prefix are also walked, and |Aut(G)|
+ * is summed over them. A group G has (n-1)! / |Aut(G)| labelled tables,
+ * so the sum divided by (n-1)! is the number of isomorphism classes, which
+ * is compared with the known value. (The labelled count is then the sum
+ * of (n-1)! / |Aut(G)| over the classes.)
+ */
+class LabelledCounter {
+    private:
+        int order;
+        bool check;
+        int depth;                          // Free cells of a prefix
+        std::vector<uint8_t> prefixes;      // Partial tables
+        size_t prefixCount;
+        std::vector<uint64_t> counts;       // Per prefix
+        std::vector<uint64_t> walked;       // Per prefix, check mode: tables visited by Next()
+        std::vector<uint64_t> autSums;      // Per prefix, check mode: sum of |Aut(G)|
+        std::vector<uint64_t> threadNodes;
+        std::atomic<size_t> next;
+        double seconds;
+        int threads;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        void Worker(int index, bool walk) {
+            try {
+                this->Work(index, walk);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(this->errorMutex);
+
+                if (!this->error) {
+                    this->error = std::current_exception();
+                }
+
+                /*
+                    Stop the other threads too.
+                */
+                this->next = this->prefixCount;
+            }
+        }
+
+        /**
+         * @param walk Check mode: visit the tables with Next() instead of counting.
+         */
+        void Work(int index, bool walk) {
+            AssocHeuristics heuristics(this->order);
+            int size = this->order * this->order;
+            size_t i;
+
+            heuristics.SetElementOrderPruning(true);
+
+            while((i = this->next.fetch_add(1)) < this->prefixCount) {
+                heuristics.LoadPrefix(&this->prefixes[i * size], this->depth);
+
+                if (!walk) {
+                    uint64_t prefixNodes = heuristics.GetNodeCount();
+                    this->counts[i] = heuristics.Count();
+                    this->threadNodes[index] += heuristics.GetNodeCount() - prefixNodes;
+                    continue;
+                }
+
+                while(true) {
+                    heuristics.Next();
+
+                    if (!heuristics.Found()) {
+                        break;
+                    }
+
+                    this->walked[i]++;
+                    this->autSums[i] += Automorphisms(this->order, heuristics.GetCayley()).GetOrder();
+                }
+            }
+        }
+
+        void RunPass(bool walk) {
+            std::vector<std::thread> workers;
+            this->next = 0;
+
+            for(int i = 0; i < this->threads; i++) {
+                workers.push_back(std::thread(&LabelledCounter::Worker, this, i, walk));
+            }
+
+            for(std::thread &worker : workers) {
+                worker.join();
+            }
+
+            if (this->error) {
+                std::rethrow_exception(this->error);
+            }
+        }
+
+    public:
+        /**
+         * @brief Number of groups of the order up to isomorphism. (OEIS A000001)
+         */
+        static uint64_t KnownGroupCount(int order) {
+            static const uint64_t counts[] = { 0, 1, 1, 1, 2, 1, 2, 1, 5, 2, 2, 1, 5, 1, 2, 1, 14,
+                1, 5, 1, 5, 2, 2, 1, 15, 2, 2, 5, 4, 1, 4, 1 };
+
+            return order >= 1 && order <= 31 ? counts[order] : 0;
+        }
+
+        /**
+         * @param check Walk the tables and sum |Aut(G)| too. (Orders up
+         * to 20, where (n-1)! fits into 64 bits.)
+         */
+        LabelledCounter(int order, bool check) : order(order), check(check), depth(order - 1), prefixCount(0),
+            next(0), seconds(0), threads(0) {
+
+            if (order < 2 || order > 31) {
+                throw std::runtime_error("Invalid order value. Allowed: 2 -> 31");
+            }
+
+            if (check && order > 20) {
+                throw std::runtime_error("The automorphism check is supported up to order 20.");
+            }
+
+            AssocHeuristics heuristics(order);
+            heuristics.SetElementOrderPruning(true);
+
+            if (this->depth >= heuristics.GetFreeCellCount()) {
+                /*
+                    Order 2: the single free cell is the search itself.
+                */
+                this->depth = 0;
+                this->prefixes.assign(heuristics.GetCayley(), heuristics.GetCayley() + order * order);
+                this->prefixCount = 1;
+                return;
+            }
+
+            heuristics.SetDepthLimit(this->depth);
+
+            while(true) {
+                heuristics.Next();
+
+                if (!heuristics.Found()) {
+                    break;
+                }
+
+                this->prefixes.insert(this->prefixes.end(), heuristics.GetCayley(),
+                    heuristics.GetCayley() + order * order);
+                this->prefixCount++;
+            }
+        }
+
+        /**
+         * @brief Counts the tables below each prefix, then walks them in
+         * check mode. Only the counting is timed. (0 threads: one per core)
+         */
+        void Run(int threads) {
+            if (threads < 1) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            this->threads = threads;
+            this->counts.assign(this->prefixCount, 0);
+            this->walked.assign(this->prefixCount, 0);
+            this->autSums.assign(this->prefixCount, 0);
+            this->threadNodes.assign(threads, 0);
+
+            auto start = std::chrono::steady_clock::now();
+            this->RunPass(false);
+            this->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (this->check) {
+                this->RunPass(true);
+            }
+        }
+
+        size_t GetPrefixCount() const {
+            return this->prefixCount;
+        }
+
+        /**
+         * @brief The row of element 2 in the prefix. (order values)
+         */
+        const uint8_t* GetPrefixRow(size_t index) const {
+            return &this->prefixes[index * this->order * this->order + this->order];
+        }
+
+        uint64_t GetCount(size_t index) const {
+            return this->counts[index];
+        }
+
+        uint64_t GetTotal() const {
+            uint64_t total = 0;
+
+            for(uint64_t count : this->counts) {
+                total += count;
+            }
+
+            return total;
+        }
+
+        uint64_t GetNodeCount() const {
+            uint64_t nodes = 0;
+
+            for(uint64_t threadNodes : this->threadNodes) {
+                nodes += threadNodes;
+            }
+
+            return nodes;
+        }
+
+        /**
+         * @brief Per prefix counts, the totals and the throughput of the counting.
+         */
+        void PrintReport(std::ostream &output) const {
+            for(size_t i = 0; i < this->prefixCount; i++) {
+                output << "Prefix " << (i + 1) << ":";
+
+                for(int x = 0; x < this->order; x++) {
+                    output << ' ' << (int)this->GetPrefixRow(i)[x];
+                }
+
+                output << " -> " << this->counts[i] << '\n';
+            }
+
+            uint64_t total = this->GetTotal();
+            uint64_t nodes = this->GetNodeCount();
+
+            output << "Labelled tables of order " << this->order << ": " << total << " (prefixes: "
+                << this->prefixCount << ", nodes: " << nodes << ", threads: " << this->threads << ", "
+                << this->seconds << " s, " << (this->seconds > 0 ? total / this->seconds : 0) << " tables/s, "
+                << (this->seconds > 0 ? nodes / this->seconds : 0) << " nodes/s)\n";
+        }
+
+        /**
+         * @brief Check mode: compares the number of walked tables with the
+         * counts, and the number of classes from the |Aut(G)| sum with the
+         * known value.
+         *
+         * @return True if everything matches.
+         */
+        bool PrintCheck(std::ostream &output) const {
+            uint64_t factorial = 1;
+            uint64_t walkedTotal = 0;
+            uint64_t autSum = 0;
+            bool ok = true;
+
+            for(int i = 2; i < this->order; i++) {
+                factorial *= i;
+            }
+
+            for(size_t i = 0; i < this->prefixCount; i++) {
+                walkedTotal += this->walked[i];
+                autSum += this->autSums[i];
+
+                if (this->walked[i] != this->counts[i]) {
+                    output << "Prefix " << (i + 1) << ": counted " << this->counts[i] << ", walked "
+                        << this->walked[i] << " - MISMATCH\n";
+                    ok = false;
+                }
+            }
+
+            output << "Walked tables: " << walkedTotal << (walkedTotal == this->GetTotal() ? " - OK" : " - MISMATCH")
+                << "\nSum of |Aut(G)|: " << autSum << " = " << (double)autSum / factorial << " * "
+                << (this->order - 1) << "!";
+
+            uint64_t known = LabelledCounter::KnownGroupCount(this->order);
+            bool classesOk = autSum % factorial == 0 && autSum / factorial == known;
+            output << ", known number of groups: " << known << (classesOk ? " - OK" : " - MISMATCH") << '\n';
+
+            return ok && walkedTotal == this->GetTotal() && classesOk;
+        }
+};
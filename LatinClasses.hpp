@@ -0,0 +1,659 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "SearchBudget.hpp"
+
+/**
+ * @brief Enumerates one Latin square from each isotopy class (row,
+ * column and symbol permutations) or main class (isotopy + the 6
+ * conjugates, which permute the roles of rows, columns and symbols).
+ *
+ * Canonical form of a k x n Latin rectangle (k rows): the smallest
+ * one, in row-major order, among all its isotopes. If the first row
+ * is mapped to the identity by the column and symbol permutations,
+ * every other row r becomes the conjugate s q_r s^-1 of the permutation
+ * q_r = row_r * row_first^-1 by the symbol permutation s. So:
+ *  - Row 1 is the identity.
+ *  - Row 2 is the smallest permutation with the smallest cycle type
+ *    among the q_r of all (first, second) row pairs: cycles of
+ *    increasing length over consecutive symbols, like (12)(345).
+ *  - For each pair with that cycle type, and each s mapping its q to
+ *    that permutation (a coset of the centralizer), the images of the
+ *    other rows are sorted. The smallest result wins.
+ *
+ * The canonical form of the first k rows of a canonical square is
+ * canonical too, so the search checks the rectangle after each row
+ * and cuts off the branches which are not canonical. Each canonical
+ * square is reduced (first row and column in order), and the second
+ * row is always one of the few canonical cycle type permutations.
+ *
+ * The main classes are filtered from the isotopy class representatives
+ * at the end: a square is kept if it is the smallest among the
+ * canonical forms of its 6 conjugates. The canonization of a conjugate
+ * stops at the first isotope smaller than the square, or when its
+ * second row is already larger.
+ * (Order 8: about 5 minutes for the isotopy classes and 8 for the main
+ * classes on a single core, both checked against the known values.)
+ */
+class LatinClasses {
+    public:
+        /*
+            Known numbers of classes for orders 1 -> 8.
+            (McKay, Meynert, Myrvold: Small Latin squares, quasigroups and loops.)
+        */
+        static uint64_t KnownIsotopyClasses(int order) {
+            static const uint64_t counts[] = { 0, 1, 1, 1, 2, 2, 22, 564, 1676267 };
+            return order >= 1 && order <= 8 ? counts[order] : 0;
+        }
+
+        static uint64_t KnownMainClasses(int order) {
+            static const uint64_t counts[] = { 0, 1, 1, 1, 2, 2, 12, 147, 283657 };
+            return order >= 1 && order <= 8 ? counts[order] : 0;
+        }
+
+    private:
+        int order;
+        bool mainClasses;
+        uint8_t *square;            // 0-based symbols, 0xFF = empty
+        uint8_t *cayley;            // The last result in the usual 1-based format.
+        uint32_t *rowValues;
+        uint32_t *columnValues;
+        uint32_t *tried;            // Per free cell (rows 3 -> n, columns 2 -> n)
+        int frameCount;
+        int depth;
+        std::vector<std::vector<uint8_t>> secondRows;
+        int secondRow;
+        bool started;
+        bool interrupted;       // The last call was stopped by its budget.
+        bool found;
+        uint64_t nodes;
+        uint64_t pruned;
+
+        /*
+            Buffers of the canonical form
+        */
+        uint8_t *best;
+        uint8_t *conjugate;
+        uint8_t sigma[32];
+        uint8_t sigmaInverse[32];
+        uint8_t rowOfKey[32];       // Row of the other rows by the first symbol of its image
+        uint8_t inverse[32];
+        uint8_t q[32];
+        bool usedBlock[32];
+
+        /**
+         * @brief The smallest permutation of the given cycle type:
+         * cycles of increasing length over consecutive symbols.
+         */
+        static void CycleTypeForm(std::vector<int> lengths, int n, uint8_t *result) {
+            std::sort(lengths.begin(), lengths.end());
+            int start = 0;
+
+            for(int length : lengths) {
+                for(int i = 0; i < length; i++) {
+                    result[start + i] = start + (i + 1) % length;
+                }
+
+                start += length;
+            }
+
+            for(int i = start; i < n; i++) {
+                result[i] = i;
+            }
+        }
+
+        /**
+         * @brief Cycle lengths of a permutation.
+         */
+        static std::vector<int> CycleType(const uint8_t *permutation, int n) {
+            std::vector<int> lengths;
+            uint32_t seen = 0;
+
+            for(int i = 0; i < n; i++) {
+                if (seen & (((uint32_t)1) << i)) {
+                    continue;
+                }
+
+                int length = 0;
+
+                for(int j = i; !(seen & (((uint32_t)1) << j)); j = permutation[j]) {
+                    seen |= ((uint32_t)1) << j;
+                    length++;
+                }
+
+                lengths.push_back(length);
+            }
+
+            return lengths;
+        }
+
+        /**
+         * @brief Derangement cycle types of n: all partitions into parts >= 2.
+         */
+        static void DerangementTypes(int n, int min, std::vector<int> &current, std::vector<std::vector<int>> &result) {
+            if (n == 0) {
+                result.push_back(current);
+                return;
+            }
+
+            for(int part = min; part <= n; part++) {
+                current.push_back(part);
+                LatinClasses::DerangementTypes(n - part, part, current, result);
+                current.pop_back();
+            }
+        }
+
+        /**
+         * @brief Compares the sorted images of the other rows for the
+         * current sigma with the best so far, and replaces it if smaller.
+         *
+         * The images are sorted by their first symbols, which are
+         * distinct (a column of the rectangle), so the rows are taken
+         * in that order, and each image is only computed as far as the
+         * comparison needs it.
+         *
+         * @return -1 if smaller than the reference, else 0.
+         */
+        int TrySigma(const uint8_t *rect, int k, int first, int second, const uint8_t *reference) {
+            int n = this->order;
+
+            for(int s = 0; s < n; s++) {
+                this->sigmaInverse[this->sigma[s]] = s;
+            }
+
+            /*
+                Rows by the first symbol of their image.
+            */
+            int column = this->inverse[this->sigmaInverse[0]];
+            memset(this->rowOfKey, 0xFF, sizeof(this->rowOfKey));
+
+            for(int r = 0; r < k; r++) {
+                if (r != first && r != second) {
+                    this->rowOfKey[this->sigma[rect[r * n + column]]] = r;
+                }
+            }
+
+            uint8_t *target = this->best + 2 * n;
+            bool smaller = false;
+
+            for(int key = 0; key < n; key++) {
+                int r = this->rowOfKey[key];
+
+                if (r == 0xFF) {
+                    continue;
+                }
+
+                const uint8_t *row = rect + r * n;
+
+                for(int p = 0; p < n; p++) {
+                    // image(p) = sigma q_r sigma^-1 (p), q_r(s) = rect[r][inverse[s]]
+                    uint8_t value = this->sigma[row[this->inverse[this->sigmaInverse[p]]]];
+
+                    if (!smaller) {
+                        if (value > target[p]) {
+                            return 0;
+                        }
+
+                        smaller = value < target[p];
+                    }
+
+                    target[p] = value;
+                }
+
+                target += n;
+            }
+
+            if (smaller && reference != nullptr && memcmp(this->best + n, reference + n, (k - 1) * n) < 0) {
+                return -1;
+            }
+
+            return 0;
+        }
+
+        /**
+         * @brief Enumerates the symbol permutations mapping the cycles
+         * of q (from cycle index "index" on) to the blocks of the form.
+         */
+        int EnumerateSigma(const std::vector<std::vector<uint8_t>> &cycles, const std::vector<int> &blockStart,
+            const std::vector<int> &blockLength, int index, const uint8_t *rect, int k, int first, int second,
+            const uint8_t *reference) {
+
+            if (index == (int)cycles.size()) {
+                return this->TrySigma(rect, k, first, second, reference);
+            }
+
+            const std::vector<uint8_t> &cycle = cycles[index];
+            int length = cycle.size();
+
+            for(int b = 0; b < (int)blockStart.size(); b++) {
+                if (this->usedBlock[b] || blockLength[b] != length) {
+                    continue;
+                }
+
+                this->usedBlock[b] = true;
+
+                for(int t = 0; t < length; t++) {
+                    for(int j = 0; j < length; j++) {
+                        this->sigma[cycle[j]] = blockStart[b] + (j + t) % length;
+                    }
+
+                    if (this->EnumerateSigma(cycles, blockStart, blockLength, index + 1, rect, k, first, second,
+                        reference) < 0) {
+
+                        this->usedBlock[b] = false;
+                        return -1;
+                    }
+                }
+
+                this->usedBlock[b] = false;
+            }
+
+            return 0;
+        }
+
+        /**
+         * @brief Computes the canonical form of a k x n Latin rectangle
+         * (0-based symbols) into "best".
+         *
+         * @param reference If given, stops as soon as an isotope smaller
+         * than it is found, or when the second row shows that none can
+         * be. ("best" is then incomplete.)
+         * @return False if an isotope smaller than the reference exists.
+         */
+        bool Canonize(const uint8_t *rect, int k, const uint8_t *reference) {
+            int n = this->order;
+
+            for(int i = 0; i < n; i++) {
+                this->best[i] = i;
+            }
+
+            if (k < 2) {
+                return true;
+            }
+
+            memset(this->best + n, 0xFF, (k - 1) * n);
+
+            /*
+                The smallest second row over all ordered pairs
+            */
+            std::vector<std::pair<int, int>> pairs;
+            uint8_t form[32];
+
+            for(int first = 0; first < k; first++) {
+                for(int s = 0; s < n; s++) {
+                    this->inverse[rect[first * n + s]] = s;
+                }
+
+                for(int second = 0; second < k; second++) {
+                    if (second == first) {
+                        continue;
+                    }
+
+                    for(int s = 0; s < n; s++) {
+                        this->q[s] = rect[second * n + this->inverse[s]];
+                    }
+
+                    LatinClasses::CycleTypeForm(LatinClasses::CycleType(this->q, n), n, form);
+                    int compare = memcmp(form, this->best + n, n);
+
+                    if (compare < 0) {
+                        memcpy(this->best + n, form, n);
+                        pairs.clear();
+
+                        if (reference != nullptr && memcmp(form, reference + n, n) < 0) {
+                            return false;
+                        }
+                    }
+
+                    if (compare <= 0) {
+                        pairs.push_back(std::make_pair(first, second));
+                    }
+                }
+            }
+
+            if (k == 2 || (reference != nullptr && memcmp(this->best + n, reference + n, n) > 0)) {
+                return true;
+            }
+
+            /*
+                The blocks of the canonical second row
+            */
+            std::vector<int> blockStart;
+            std::vector<int> blockLength;
+
+            for(int start = 0; start < n; ) {
+                int length = 1;
+
+                while(this->best[n + start + length - 1] != start) {
+                    length++;
+                }
+
+                blockStart.push_back(start);
+                blockLength.push_back(length);
+                start += length;
+            }
+
+            for(const std::pair<int, int> &pair : pairs) {
+                int first = pair.first;
+                int second = pair.second;
+
+                for(int s = 0; s < n; s++) {
+                    this->inverse[rect[first * n + s]] = s;
+                }
+
+                for(int s = 0; s < n; s++) {
+                    this->q[s] = rect[second * n + this->inverse[s]];
+                }
+
+                /*
+                    Cycles of q in the order of the blocks (by length).
+                */
+                std::vector<std::vector<uint8_t>> cycles;
+                uint32_t seen = 0;
+
+                for(int i = 0; i < n; i++) {
+                    if (seen & (((uint32_t)1) << i)) {
+                        continue;
+                    }
+
+                    std::vector<uint8_t> cycle;
+
+                    for(int j = i; !(seen & (((uint32_t)1) << j)); j = this->q[j]) {
+                        seen |= ((uint32_t)1) << j;
+                        cycle.push_back(j);
+                    }
+
+                    cycles.push_back(cycle);
+                }
+
+                memset(this->usedBlock, 0, sizeof(this->usedBlock));
+
+                if (this->EnumerateSigma(cycles, blockStart, blockLength, 0, rect, k, first, second, reference) < 0) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief True if the current square is the smallest among the
+         * canonical forms of its conjugates.
+         */
+        bool IsMainClassRepresentative() {
+            int n = this->order;
+            int roles[6][3] = { {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0} };
+
+            for(int c = 1; c < 6; c++) {
+                for(int r = 0; r < n; r++) {
+                    for(int col = 0; col < n; col++) {
+                        int triple[3] = { r, col, this->square[r * n + col] };
+                        this->conjugate[triple[roles[c][0]] * n + triple[roles[c][1]]] = triple[roles[c][2]];
+                    }
+                }
+
+                /*
+                    Stops at the first isotope smaller than the square.
+                */
+                if (!this->Canonize(this->conjugate, n, this->square)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        inline int FrameRow(int d) {
+            return 2 + d / (this->order - 1);
+        }
+
+        inline int FrameColumn(int d) {
+            return 1 + d % (this->order - 1);
+        }
+
+        /**
+         * @brief Fills in the fixed rows: the identity and the current
+         * canonical second row.
+         */
+        void LoadSecondRow() {
+            int n = this->order;
+
+            memset(this->square, 0xFF, n * n);
+            memset(this->rowValues, 0, n * sizeof(uint32_t));
+            memset(this->columnValues, 0, n * sizeof(uint32_t));
+            memset(this->tried, 0, (this->frameCount + 1) * sizeof(uint32_t));
+
+            for(int i = 0; i < n; i++) {
+                this->Put(0, i, i);
+
+                if (n > 1) {
+                    this->Put(1, i, this->secondRows[this->secondRow][i]);
+                }
+
+                if (i >= 2) {
+                    this->Put(i, 0, i);
+                }
+            }
+
+            this->depth = 0;
+        }
+
+        inline void Put(int row, int column, int value) {
+            uint32_t bit = ((uint32_t)1) << value;
+            this->square[row * this->order + column] = value;
+            this->rowValues[row] |= bit;
+            this->columnValues[column] |= bit;
+        }
+
+        inline void Remove(int row, int column) {
+            uint32_t bit = ((uint32_t)1) << this->square[row * this->order + column];
+            this->square[row * this->order + column] = 0xFF;
+            this->rowValues[row] &= ~bit;
+            this->columnValues[column] &= ~bit;
+        }
+
+    public:
+        /**
+         * @param mainClasses False: one square per isotopy class.
+         * True: one square per main class.
+         */
+        LatinClasses(int order, bool mainClasses) : order(order), mainClasses(mainClasses) {
+            if (order < 1 || order > 31) {
+                throw std::runtime_error("Invalid order value. Allowed: 1 -> 31");
+            }
+
+            int n = order;
+            this->square = new uint8_t[n * n];
+            this->cayley = new uint8_t[n * n];
+            this->rowValues = new uint32_t[n];
+            this->columnValues = new uint32_t[n];
+            this->frameCount = n > 2 ? (n - 2) * (n - 1) : 0;
+            this->tried = new uint32_t[this->frameCount + 1];
+            this->best = new uint8_t[n * n];
+            this->conjugate = new uint8_t[n * n];
+            this->started = false;
+            this->interrupted = false;
+            this->found = false;
+            this->nodes = 0;
+            this->pruned = 0;
+            this->secondRow = 0;
+
+            /*
+                The canonical second rows: one per derangement cycle type.
+            */
+            if (n > 1) {
+                std::vector<std::vector<int>> types;
+                std::vector<int> current;
+                LatinClasses::DerangementTypes(n, 2, current, types);
+
+                for(const std::vector<int> &type : types) {
+                    std::vector<uint8_t> row(n);
+                    LatinClasses::CycleTypeForm(type, n, &row[0]);
+                    this->secondRows.push_back(row);
+                }
+
+                std::sort(this->secondRows.begin(), this->secondRows.end());
+            } else {
+                this->secondRows.push_back(std::vector<uint8_t>(1, 0));
+            }
+        }
+
+        ~LatinClasses() {
+            delete[] this->square;
+            delete[] this->cayley;
+            delete[] this->rowValues;
+            delete[] this->columnValues;
+            delete[] this->tried;
+            delete[] this->best;
+            delete[] this->conjugate;
+        }
+
+    private:
+        /**
+         * @brief The search loop of Next(). With a budget, it stops before
+         * a node and continues from there in the next call.
+         */
+        SearchStatus Search(SearchBudget *budget) {
+            int n = this->order;
+            bool backtrack = this->started && !this->interrupted;
+            uint64_t visited = 0;
+            this->found = false;
+            this->interrupted = false;
+
+            if (!this->started) {
+                this->started = true;
+                this->LoadSecondRow();
+            }
+
+            while(true) {
+                if (backtrack) {
+                    /*
+                        Go back to the previous free cell, or to the next second row.
+                    */
+                    if (this->depth == 0) {
+                        this->secondRow++;
+
+                        if (this->secondRow >= (int)this->secondRows.size() || n < 2) {
+                            return SearchStatus::Finished;
+                        }
+
+                        this->LoadSecondRow();
+                        backtrack = false;
+                    } else {
+                        this->depth--;
+                        this->Remove(this->FrameRow(this->depth), this->FrameColumn(this->depth));
+                        backtrack = false;
+                    }
+                }
+
+                if (budget != nullptr && budget->IsExhausted(visited++)) {
+                    this->interrupted = true;
+                    return SearchStatus::BudgetExhausted;
+                }
+
+                if (this->depth >= this->frameCount) {
+                    /*
+                        Complete square
+                    */
+                    if (!this->mainClasses || this->IsMainClassRepresentative()) {
+                        for(int i = 0; i < n * n; i++) {
+                            this->cayley[i] = this->square[i] + 1;
+                        }
+
+                        this->found = true;
+                        return SearchStatus::Found;
+                    }
+
+                    backtrack = true;
+                    continue;
+                }
+
+                int row = this->FrameRow(this->depth);
+                int column = this->FrameColumn(this->depth);
+                uint32_t &tried = this->tried[this->depth];
+                uint32_t free = ~(tried | this->rowValues[row] | this->columnValues[column]);
+                int value = __builtin_ffs(free) - 1;
+
+                if (value < 0 || value >= n) {
+                    tried = 0;
+                    backtrack = true;
+                    continue;
+                }
+
+                tried |= ((uint32_t)1) << value;
+                this->Put(row, column, value);
+                this->nodes++;
+
+                if (column == n - 1) {
+                    /*
+                        Row completed: is the rectangle canonical?
+                    */
+                    if (!this->Canonize(this->square, row + 1, this->square)) {
+                        this->Remove(row, column);
+                        this->pruned++;
+                        continue;
+                    }
+                }
+
+                this->depth++;
+            }
+        }
+
+    public:
+        /**
+         * @brief Finds the next class representative.
+         * @return False if there are no more. (Check Found() too.)
+         */
+        bool Next() {
+            return this->Search(nullptr) == SearchStatus::Found;
+        }
+
+        /**
+         * @brief Next() within the limits of the budget. After
+         * BudgetExhausted, call it again to continue.
+         */
+        SearchStatus Next(SearchBudget &budget) {
+            return this->Search(&budget);
+        }
+
+        bool Found() {
+            return this->found;
+        }
+
+        /**
+         * @brief The last representative in the 1-based format of the other modules.
+         */
+        uint8_t* GetCayley() {
+            return this->cayley;
+        }
+
+        uint64_t GetNodeCount() {
+            return this->nodes;
+        }
+
+        /**
+         * @brief Number of rectangles cut off as not canonical.
+         */
+        uint64_t GetPrunedCount() {
+            return this->pruned;
+        }
+};
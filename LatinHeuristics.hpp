@@ -22,6 +22,11 @@
 #include <iomanip>
 #include <sstream>
 #include <string.h>
+#include "SearchArena.hpp"
+#include "SearchTrail.hpp"
+#include "AllDifferent.hpp"
+#include "SearchBudget.hpp"
+#include "TableWriter.hpp"
 
 /**
  * @brief Find quasigroups, which might lack the associative property.
@@ -34,45 +39,45 @@ class LatinHeuristics {
         int order;
         int size;
         uint8_t *cayley;   // Cayley table
-        uint32_t *track;    // Bitmap of already used values.
+        SearchArena arena;  // The memory of the arrays. (Except AllDifferent.)
+        SearchTrail trail;  // Assignment stack and undo log.
+        SearchTrail::Frame *frames;
         uint32_t *rows;     // Bitmap of currently used values in rows.
         uint32_t *columns;  // Bitmap of currently used values in columns.
+        uint32_t *pruned;   // Bitmaps of the values removed from the cells by propagation.
+        AllDifferent *allDifferent; // Row and column filtering. (Optional)
         int x;
         int y;
         int pos;
+        int depth;          // Index of the current frame.
         bool found;
         
+        inline void LoadFrame() {
+            this->pos = this->frames[this->depth].pos;
+            this->x = this->frames[this->depth].x;
+            this->y = this->frames[this->depth].y;
+        }
+
         inline bool StepForward() {
-            if (this->x >= this->order - 1) {
-                if (this->y >= this->order - 1) {
-                    return false;
-                }
-                
-                this->x = 1;
-                this->y++;
-                this->pos += 2;
-            } else {
-                this->x++;
-                this->pos++;
+            if (this->depth >= this->trail.GetFrameCount() - 1) {
+                return false;
             }
 
+            this->depth++;
+            this->trail.Enter(this->depth);
+            this->LoadFrame();
+
             return true;
         }
 
         inline bool StepBackward() {
-            if (this->x <= 1) {
-                if (this->y <= 1) {
-                    return false;
-                }
-                
-                this->x = this->order - 1;
-                this->y--;
-                this->pos -= 2;
-            } else {
-                this->x--;
-                this->pos--;
+            if (this->depth <= 0) {
+                return false;
             }
 
+            this->depth--;
+            this->LoadFrame();
+
             return true;
         }
 
@@ -80,37 +85,29 @@ class LatinHeuristics {
             uint32_t bit = ((uint32_t)1) << (value - 1);
 
             this->cayley[this->pos] = value;
-            this->track[this->pos] |= bit;
-            this->rows[this->y] |= bit;
-            this->columns[this->x] |= bit;
+            this->frames[this->depth].tried |= bit;
+            this->trail.Or(this->y, bit);
+            this->trail.Or(this->order + this->x, bit);
 
             /*std::cout << "Columns[4]: " << std::bitset<32>(this->columns[4]) << '\n';
             std::cout << "Rows[1]: " << std::bitset<32>(this->rows[1]) << '\n';
-            std::cout << "Track[9]: " << std::bitset<32>(this->track[9]) << '\n';
+            std::cout << "Tried: " << std::bitset<32>(this->frames[this->depth].tried) << '\n';
             */
             //std::cout << this->GetAsText() << '\n';
         }
 
-        inline void Unset(bool isBackTracking) {
-            if (isBackTracking) {
-                this->track[this->pos] = 0;
-            }
-
-            uint8_t value = this->cayley[this->pos];
-            if (value == 0) {
-                // Nothing to unset
-                return;
-            }
-
-            uint32_t bit = ~(((uint32_t)1) << (value - 1));
-
+        /**
+         * @brief Clears the cell of the current frame and undoes
+         * the changes of its assignment. The tried values are kept.
+         */
+        inline void Unset() {
             this->cayley[this->pos] = 0;
-            this->rows[this->y] &= bit;
-            this->columns[this->x] &= bit;
+            this->trail.Undo(this->frames[this->depth].mark);
         }
 
         inline int FindPossibleValue() {
-            uint32_t bitMap = ~(this->track[this->pos] | this->rows[this->y] | this->columns[this->x]);
+            uint32_t bitMap = ~(this->frames[this->depth].tried | this->rows[this->y] | this->columns[this->x]
+                | this->pruned[this->pos]);
             
             // https://gcc.gnu.org/onlinedocs/gcc-4.8.0/gcc/Other-Builtins.html
             return __builtin_ffs(bitMap);
@@ -122,37 +119,59 @@ class LatinHeuristics {
             while(this->StepBackward()) {
                 next = this->FindPossibleValue();
                 if (next <= this->order) {
-                    this->Unset(false);
+                    this->Unset();
                     return next;
                 }
 
-                this->Unset(true);
+                this->Unset();
             }
 
             return this->order + 1;
         }
 
     public:
-        LatinHeuristics(uint8_t order) {
+        /**
+         * @brief Size of the arena of an engine: the undo log, the bitmaps,
+         * the frames and the table, then the snapshot of the last three.
+         */
+        static size_t ArenaBytes(int order) {
             if (order < 2 || order > 31) {
                 throw std::runtime_error("Invalid order value. Allowed: 2 -> 31");
             }
-            
+
+            int maskCount = 2 * order + order * order;
+            int frameCount = (order - 1) * (order - 1);
+            size_t state = SearchTrail::StateBytes(maskCount, frameCount) + SearchArena::Bytes<uint8_t>(order * order);
+
+            return SearchTrail::ArenaBytes(maskCount, frameCount) + SearchArena::Bytes<uint8_t>(order * order) + state;
+        }
+
+        LatinHeuristics(uint8_t order)
+            : arena(LatinHeuristics::ArenaBytes(order)),
+              trail(2 * order + order * order, (order - 1) * (order - 1), arena) {
+
             this->order = order;
             this->size = order * order;
-            this->cayley = new uint8_t[this->size];
-            this->track = new uint32_t[this->size];
-            this->rows = new uint32_t[order];
-            this->columns = new uint32_t[order];
-            this->x = 1;
-            this->y = 1;
-            this->pos = this->order + 1;
+            this->cayley = this->arena.Take<uint8_t>(this->size);
+            this->arena.MarkSnapshot(this->trail.GetMasks());
+            this->frames = this->trail.GetFrames();
+            this->rows = this->trail.GetMasks();
+            this->columns = this->rows + order;
+            this->pruned = this->rows + 2 * order;
+            this->allDifferent = nullptr;
+            this->depth = 0;
             this->found = false;
 
-            memset(this->cayley, 0, this->size * sizeof(uint8_t));
-            memset(this->track, 0, this->size * sizeof(uint32_t));
-            memset(this->rows, 0, order * sizeof(uint32_t));
-            memset(this->columns, 0, order * sizeof(uint32_t));
+            /*
+                Visit order: the free cells in raster order.
+            */
+            for(int d = 0; d < this->trail.GetFrameCount(); d++) {
+                int y = 1 + d / (order - 1);
+                int x = 1 + d % (order - 1);
+                this->trail.SetFrameCell(d, y * order + x, x, y);
+            }
+
+            this->LoadFrame();
 
             /*
                 Fixed values
@@ -170,38 +189,80 @@ class LatinHeuristics {
                 *(this->cayley + i * this->order) = i + 1;
                 this->rows[i] |= 1 << i;
             }
+
+            this->arena.SaveSnapshot();
         }
 
         ~LatinHeuristics() {
-            delete[] this->cayley;
-            delete[] this->track;
-            delete[] this->rows;
-            delete[] this->columns;
+            delete this->allDifferent;
         }
 
-        bool Next() {
+        /**
+         * @brief Returns to the initial state with one copy of the arrays
+         * from their snapshot. The options are kept.
+         */
+        void Reset() {
+            this->arena.RestoreSnapshot();
+            this->trail.ClearLog();
+            this->depth = 0;
+            this->LoadFrame();
+            this->found = false;
+        }
+
+        /**
+         * @brief Enables the all-different filtering of the rows and
+         * columns after each assignment. (See AllDifferent.)
+         * Call it before the first Next().
+         */
+        void SetAllDifferent(bool enabled) {
+            delete this->allDifferent;
+            this->allDifferent = enabled ? new AllDifferent(this->order) : nullptr;
+        }
+
+    private:
+        /**
+         * @brief The search loop of Next(). With a budget, it can stop at
+         * the start of a node: the state is the same as before visiting it,
+         * so the next call continues from there.
+         */
+        SearchStatus Search(SearchBudget *budget) {
             int next;
+            uint64_t visited = 0;
             this->found = false;
 
             do {
-                /*
-                    Search for a possible value
-                */
-                next = this->FindPossibleValue();
-                
-                if (next > this->order) {
+                while(true) {
+                    if (budget != nullptr && budget->IsExhausted(visited++)) {
+                        return SearchStatus::BudgetExhausted;
+                    }
+
                     /*
-                        No value left to be tried => backtracking
+                        Search for a possible value
                     */
-                    this->Unset(true);
-                    next = this->BackTracking();
+                    next = this->FindPossibleValue();
+                    
                     if (next > this->order) {
-                        return false;
+                        /*
+                            No value left to be tried => backtracking
+                        */
+                        this->Unset();
+                        next = this->BackTracking();
+                        if (next > this->order) {
+                            return SearchStatus::Finished;
+                        }
                     }
-                }
 
-                this->Unset(false);
-                this->Set(next);
+                    this->Unset();
+                    this->Set(next);
+
+                    if (this->allDifferent == nullptr
+                        || this->allDifferent->Propagate(this->trail, this->cayley, 2 * this->order, this->x, this->y)) {
+                        
+                        break;
+                    }
+
+                    // A row or column can't be completed => try the next value
+                }
 
                 //std::cin.get();
 
@@ -209,28 +270,30 @@ class LatinHeuristics {
 
             this->found = true;
 
-            if (next > this->order) {
-                // Last one
-                return false;
-            }
-
-            // More to be expected
-            return true;
+            return SearchStatus::Found;
         }
 
-        std::string GetAsText() {
-            std::stringstream result;
+    public:
+        /**
+         * @return True if a table was found. (Check Found() too.)
+         */
+        bool Next() {
+            return this->Search(nullptr) == SearchStatus::Found;
+        }
 
-            for(int i = 0; i < this->order; i++) {
-                for(int j = 0; j < this->order; j++) {
-                    result << std::setfill('0') << std::setw(2)
-                        << (int)(*(this->cayley + j + i * this->order)) << ";";
-                }
+        /**
+         * @brief Next() within the limits of the budget. After
+         * BudgetExhausted, call it again to continue.
+         */
+        SearchStatus Next(SearchBudget &budget) {
+            return this->Search(&budget);
+        }
 
-                result << '\n';
-            }
+        std::string GetAsText() {
+            TableWriter writer;
+            writer.WriteTable(this->order, this->cayley);
 
-            return result.str();
+            return writer.ToString();
         }
 
         bool Found() {
@@ -0,0 +1,336 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <stdexcept>
+
+/**
+ * @brief Counts or enumerates the reduced Latin squares of small orders
+ * (2 -> 8) by running many partial squares in lockstep.
+ *
+ * The cells are visited in the order of LatinHeuristics (the free cells
+ * in raster order). A partial square is a lane: the used values of its
+ * rows and columns, 8 bits each, in two 64 bit words. The partial
+ * squares waiting at each depth are kept in a stack per depth. A step
+ * takes 8 lanes from the deepest stack: the row and column masks of the
+ * current cell are gathered into one word (byte i for lane i), and the
+ * candidates of all 8 lanes are computed with one OR and one NOT. The
+ * children are pushed to the next depth. There are no tried masks and
+ * no backtracking: a lane is finished when its children are pushed.
+ *
+ * A Latin rectangle with n - 1 complete rows has exactly one completion,
+ * so the search stops at the last cell of row n - 2. There the number of
+ * completions of the 8 lanes is the popcount of the candidate word.
+ *
+ * The squares are enumerated depth-first, but not in the order of
+ * LatinHeuristics. At most 8 * n lanes wait at a depth.
+ */
+class LatinLanes {
+    private:
+        struct Lane {
+            uint64_t rows;          // Byte y: values used in row y
+            uint64_t columns;       // Byte x: values used in column x
+        };
+
+        int order;
+        int size;
+        int lastDepth;                                  // The last free cell of row n - 2
+        uint64_t valueMask;                             // The values in each byte
+        std::vector<int> cellX;
+        std::vector<int> cellY;
+        std::vector<Lane> lanes;                        // The waiting lanes of all depths
+        std::vector<uint8_t> cells;                     // The tables of the lanes (when enumerating)
+        std::vector<size_t> levelStart;                 // [depth] -> index in "lanes"
+        std::vector<size_t> levelCount;
+        uint64_t fullLevels;                            // Bit d: at least 8 lanes at depth d
+        uint64_t usedLevels;                            // Bit d: at least 1 lane at depth d
+        std::vector<uint8_t> roots;                     // Prefix tables
+        std::vector<int> rootDepths;
+        std::vector<uint8_t> square;
+        uint64_t steps;
+
+        inline void UpdateLevel(int depth) {
+            uint64_t bit = (uint64_t)1 << depth;
+            size_t count = this->levelCount[depth];
+
+            this->fullLevels = count >= 8 ? (this->fullLevels | bit) : (this->fullLevels & ~bit);
+            this->usedLevels = count > 0 ? (this->usedLevels | bit) : (this->usedLevels & ~bit);
+        }
+
+        /**
+         * @brief The lanes of the prefixes, or the first row and column.
+         * Each depth gets room for its roots plus 8 * n lanes. (A depth
+         * which is not full receives at most 8 * (n - 1) children.)
+         */
+        void LoadRoots(bool enumerate) {
+            int n = this->order;
+            int levels = this->levelStart.size();
+            std::vector<uint8_t> empty(this->size, 0);
+            std::vector<size_t> rootsAt(levels, 0);
+
+            for(int i = 0; i < n; i++) {
+                empty[i] = i + 1;
+                empty[i * n] = i + 1;
+            }
+
+            if (this->rootDepths.empty()) {
+                this->roots = empty;
+                this->rootDepths.push_back(0);
+            }
+
+            for(int depth : this->rootDepths) {
+                rootsAt[depth]++;
+            }
+
+            size_t total = 0;
+
+            for(int d = 0; d < levels; d++) {
+                this->levelStart[d] = total;
+                this->levelCount[d] = 0;
+                total += rootsAt[d] + 8 * n;
+            }
+
+            this->lanes.resize(total);
+
+            if (enumerate) {
+                this->cells.resize(total * this->size);
+            }
+
+            for(size_t r = 0; r < this->rootDepths.size(); r++) {
+                const uint8_t *table = &this->roots[r * this->size];
+                int depth = this->rootDepths[r];
+                Lane lane = { 0, 0 };
+
+                for(int y = 0; y < n; y++) {
+                    for(int x = 0; x < n; x++) {
+                        int value = table[y * n + x];
+
+                        if (value == 0) {
+                            continue;
+                        }
+
+                        uint64_t bit = (uint64_t)1 << (value - 1);
+
+                        if (((lane.rows >> (8 * y)) | (lane.columns >> (8 * x))) & bit) {
+                            throw std::runtime_error("LatinLanes: the prefix is not a partial Latin square.");
+                        }
+
+                        lane.rows |= bit << (8 * y);
+                        lane.columns |= bit << (8 * x);
+                    }
+                }
+
+                size_t index = this->levelStart[depth] + this->levelCount[depth]++;
+                this->lanes[index] = lane;
+
+                if (enumerate) {
+                    memcpy(&this->cells[index * this->size], table, this->size);
+                }
+            }
+
+            this->fullLevels = 0;
+            this->usedLevels = 0;
+
+            for(int d = 0; d < levels; d++) {
+                this->UpdateLevel(d);
+            }
+        }
+
+        /**
+         * @brief Fills the last row of a table with n - 1 complete rows.
+         */
+        void Complete(const uint8_t *table, uint64_t columns) {
+            int n = this->order;
+            memcpy(&this->square[0], table, this->size);
+
+            for(int x = 1; x < n; x++) {
+                uint64_t missing = ~(columns >> (8 * x)) & this->valueMask & 0xFF;
+                this->square[(n - 1) * n + x] = __builtin_ffsll(missing);
+            }
+        }
+
+        /**
+         * @brief Takes the deepest depth with at least 8 lanes, or if
+         * there is none, the deepest one with any.
+         */
+        template<bool enumerate, typename Callback>
+        uint64_t Run(Callback &callback) {
+            int n = this->order;
+            int last = this->lastDepth;
+            uint64_t total = 0;
+
+            this->LoadRoots(enumerate);
+
+            /*
+                Roots which are already complete up to row n - 2.
+            */
+            for(int depth = last + 1; depth < (int)this->levelStart.size(); depth++) {
+                for(size_t i = 0; i < this->levelCount[depth]; i++) {
+                    size_t index = this->levelStart[depth] + i;
+
+                    if (enumerate) {
+                        this->Complete(&this->cells[index * this->size], this->lanes[index].columns);
+                        callback((const uint8_t *)&this->square[0]);
+                    }
+
+                    total++;
+                }
+
+                this->levelCount[depth] = 0;
+                this->UpdateLevel(depth);
+            }
+
+            while(this->usedLevels) {
+                uint64_t pick = this->fullLevels ? this->fullLevels : this->usedLevels;
+                int depth = 63 - __builtin_clzll(pick);
+                size_t &levelSize = this->levelCount[depth];
+                int count = levelSize < 8 ? levelSize : 8;
+                size_t base = this->levelStart[depth] + levelSize - count;
+                int shiftY = 8 * this->cellY[depth];
+                int shiftX = 8 * this->cellX[depth];
+                uint64_t used = 0;
+
+                for(int i = 0; i < count; i++) {
+                    const Lane &lane = this->lanes[base + i];
+                    used |= (((lane.rows >> shiftY) | (lane.columns >> shiftX)) & 0xFF) << (8 * i);
+                }
+
+                uint64_t laneMask = count == 8 ? ~(uint64_t)0 : ((uint64_t)1 << (8 * count)) - 1;
+                uint64_t candidates = ~used & laneMask & this->valueMask;
+
+                levelSize -= count;
+                this->UpdateLevel(depth);
+                this->steps++;
+
+                if (depth == last && !enumerate) {
+                    total += __builtin_popcountll(candidates);
+                    continue;
+                }
+
+                /*
+                    The count is kept in a local variable: the stores
+                    of the lanes could alias it.
+                */
+                int pos = this->cellY[depth] * n + this->cellX[depth];
+                Lane *children = &this->lanes[0] + this->levelStart[depth + 1];
+                size_t childCount = depth < last ? this->levelCount[depth + 1] : 0;
+
+                for(int i = 0; i < count; i++) {
+                    uint64_t values = (candidates >> (8 * i)) & 0xFF;
+                    Lane lane = this->lanes[base + i];
+
+                    while(values) {
+                        uint64_t bit = values & -values;
+                        Lane child = { lane.rows | (bit << shiftY), lane.columns | (bit << shiftX) };
+                        values ^= bit;
+
+                        if (enumerate) {
+                            uint8_t *table = &this->cells[(base + i) * this->size];
+                            table[pos] = __builtin_ffsll(bit);
+
+                            if (depth == last) {
+                                this->Complete(table, child.columns);
+                                callback((const uint8_t *)&this->square[0]);
+                                total++;
+                                continue;
+                            }
+
+                            memcpy(&this->cells[(this->levelStart[depth + 1] + childCount) * this->size],
+                                table, this->size);
+                        }
+
+                        children[childCount++] = child;
+                    }
+                }
+
+                if (depth < last) {
+                    this->levelCount[depth + 1] = childCount;
+                    this->UpdateLevel(depth + 1);
+                }
+            }
+
+            this->roots.clear();
+            this->rootDepths.clear();
+
+            return total;
+        }
+
+    public:
+        LatinLanes(int order) : order(order), size(order * order), fullLevels(0), usedLevels(0), steps(0) {
+            if (order < 2 || order > 8) {
+                throw std::runtime_error("Invalid order value. Allowed: 2 -> 8");
+            }
+
+            int frames = (order - 1) * (order - 1);
+            this->lastDepth = (order - 2) * (order - 1) - 1;
+            this->valueMask = 0;
+
+            for(int i = 0; i < 8; i++) {
+                this->valueMask |= (uint64_t)((1 << order) - 1) << (8 * i);
+            }
+
+            for(int d = 0; d < frames; d++) {
+                this->cellY.push_back(1 + d / (order - 1));
+                this->cellX.push_back(1 + d % (order - 1));
+            }
+
+            this->levelStart.resize(frames + 1);
+            this->levelCount.resize(frames + 1);
+            this->square.resize(this->size);
+        }
+
+        /**
+         * @brief Adds a subtree: a reduced partial square with its first
+         * "depth" free cells filled (in raster order, as in
+         * AssocHeuristics::LoadPrefix). Without prefixes the whole tree
+         * is searched.
+         */
+        void AddPrefix(const uint8_t *cayley, int depth) {
+            if (depth < 0 || depth > (this->order - 1) * (this->order - 1)) {
+                throw std::runtime_error("LatinLanes: invalid prefix depth.");
+            }
+
+            this->roots.insert(this->roots.end(), cayley, cayley + this->size);
+            this->rootDepths.push_back(depth);
+        }
+
+        /**
+         * @brief The number of reduced Latin squares below the prefixes.
+         */
+        uint64_t Count() {
+            auto ignore = [](const uint8_t *) { };
+            return this->Run<false>(ignore);
+        }
+
+        /**
+         * @brief Calls callback(const uint8_t *cayley) with each square
+         * (1-based values) and returns their number.
+         */
+        template<typename Callback>
+        uint64_t Enumerate(Callback callback) {
+            return this->Run<true>(callback);
+        }
+
+        /**
+         * @brief Number of 8 lane steps.
+         */
+        uint64_t GetStepCount() const {
+            return this->steps;
+        }
+};
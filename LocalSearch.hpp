@@ -0,0 +1,413 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <random>
+#include <stdexcept>
+#include "JacobsonMatthews.hpp"
+
+/**
+ * @brief Incomplete search for groups: keeps a full Latin square and
+ * minimizes the number of violated associativity triples
+ *      (a * b) * c != a * (b * c)
+ * with simulated annealing. An associative Latin square is a group, so
+ * the search stops when the count reaches zero.
+ *
+ * Starts from a random square of JacobsonMatthews. A move is a cycle
+ * swap, which keeps the square Latin: the entries of two rows (or two
+ * columns) are exchanged along one cycle of the permutation between
+ * them, or two symbols are exchanged along one cycle of the cells
+ * containing them. The first cell of the cycle is picked from the cells
+ * which are part of violated triples.
+ *
+ * A cell (x, y) is used by 4n triples: (x, y, c), (a, b, y) with
+ * a * b = x, (a, x, y) and (x, b, c) with b * c = y. The change of the
+ * count is computed only on the triples which use a changed cell, so a
+ * move costs O(n * cycle length), instead of the O(n^3) of a full
+ * check. The number of violated triples using each cell is kept up to
+ * date too.
+ */
+class LocalSearch {
+    private:
+        int order;
+        std::vector<uint8_t> table;           // 0-based symbols
+        std::vector<uint8_t> rowColumn;       // [row * order + symbol] -> column
+        std::vector<uint8_t> columnRow;       // [column * order + symbol] -> row
+        std::vector<uint32_t> cellViolations;
+        std::vector<uint32_t> stamps;         // Deduplication of the affected triples.
+        std::vector<uint32_t> affected;       // Triples: (a * order + b) * order + c
+        std::vector<int> changedCells;
+        std::vector<uint8_t> cayley;
+        std::mt19937_64 random;
+        uint32_t stamp;
+        uint64_t violations;
+        uint64_t moves;
+        uint64_t accepted;
+        double initialTemperature;
+        double temperature;
+        double cooling;
+
+        inline int Mult(int a, int b) const {
+            return this->table[a * this->order + b];
+        }
+
+        inline bool IsViolated(uint32_t triple) const {
+            int n = this->order;
+            int c = triple % n;
+            int b = (triple / n) % n;
+            int a = triple / (n * n);
+
+            return this->Mult(this->Mult(a, b), c) != this->Mult(a, this->Mult(b, c));
+        }
+
+        /**
+         * @brief Adds "delta" to the counts of the 4 cells the triple uses.
+         */
+        inline void CountCells(uint32_t triple, int delta) {
+            int n = this->order;
+            int c = triple % n;
+            int b = (triple / n) % n;
+            int a = triple / (n * n);
+            int ab = this->Mult(a, b);
+            int bc = this->Mult(b, c);
+
+            this->cellViolations[a * n + b] += delta;
+            this->cellViolations[ab * n + c] += delta;
+            this->cellViolations[b * n + c] += delta;
+            this->cellViolations[a * n + bc] += delta;
+        }
+
+        inline void AddTriple(int a, int b, int c) {
+            uint32_t triple = (a * this->order + b) * this->order + c;
+
+            if (this->stamps[triple] != this->stamp) {
+                this->stamps[triple] = this->stamp;
+                this->affected.push_back(triple);
+            }
+        }
+
+        /**
+         * @brief Collects the triples which use the cell in the current table.
+         */
+        void CollectTriples(int x, int y) {
+            int n = this->order;
+
+            for(int i = 0; i < n; i++) {
+                this->AddTriple(x, y, i);
+                this->AddTriple(i, this->rowColumn[i * n + x], y);
+                this->AddTriple(i, x, y);
+                this->AddTriple(x, i, this->rowColumn[i * n + y]);
+            }
+        }
+
+        inline void Put(int row, int column, int value) {
+            int n = this->order;
+            this->table[row * n + column] = value;
+            this->rowColumn[row * n + value] = column;
+            this->columnRow[column * n + value] = row;
+        }
+
+        /**
+         * @brief Cycle of the row (or column) swap containing the cell.
+         * Stores the changed cells.
+         */
+        void FindCycle(bool rows, int line1, int line2, int start) {
+            int n = this->order;
+            int position = start;
+            this->changedCells.clear();
+
+            do {
+                if (rows) {
+                    this->changedCells.push_back(line1 * n + position);
+                    this->changedCells.push_back(line2 * n + position);
+                    position = this->rowColumn[line1 * n + this->Mult(line2, position)];
+                } else {
+                    this->changedCells.push_back(position * n + line1);
+                    this->changedCells.push_back(position * n + line2);
+                    position = this->columnRow[line1 * n + this->Mult(position, line2)];
+                }
+            } while(position != start);
+        }
+
+        /**
+         * @brief Cycle of the symbol swap (symbol of the cell <-> other)
+         * containing the cell. Stores the changed cells in pairs of the
+         * same row.
+         */
+        void FindSymbolCycle(int row, int column, int other) {
+            int n = this->order;
+            int symbol = this->Mult(row, column);
+            this->changedCells.clear();
+
+            do {
+                int next = this->rowColumn[row * n + other];
+                this->changedCells.push_back(row * n + column);
+                this->changedCells.push_back(row * n + next);
+                column = next;
+                row = this->columnRow[column * n + symbol];
+            } while(row * n + column != this->changedCells[0]);
+        }
+
+        /**
+         * @brief Exchanges the values of the cell pairs in changedCells.
+         * (Its own inverse.)
+         */
+        void Swap() {
+            int n = this->order;
+
+            for(size_t i = 0; i < this->changedCells.size(); i += 2) {
+                int first = this->changedCells[i];
+                int second = this->changedCells[i + 1];
+                int value1 = this->table[first];
+                int value2 = this->table[second];
+
+                this->Put(first / n, first % n, value2);
+                this->Put(second / n, second % n, value1);
+            }
+        }
+
+        int CountAffected() const {
+            int count = 0;
+
+            for(uint32_t triple : this->affected) {
+                count += this->IsViolated(triple);
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief A cell which is part of violated triples, if one is found in a few tries.
+         */
+        int PickCell() {
+            int n = this->order;
+            int cell = 0;
+
+            for(int i = 0; i < 2 * n; i++) {
+                cell = std::uniform_int_distribution<int>(0, n * n - 1)(this->random);
+
+                if (this->cellViolations[cell] > 0) {
+                    break;
+                }
+            }
+
+            return cell;
+        }
+
+        /**
+         * @brief One move of the annealing.
+         */
+        void Move() {
+            int n = this->order;
+            int cell = this->PickCell();
+            int row = cell / n;
+            int column = cell % n;
+            int kind = std::uniform_int_distribution<int>(0, 2)(this->random);
+            int other = std::uniform_int_distribution<int>(0, n - 2)(this->random);
+
+            if (kind == 0) {
+                other += (other >= row);
+                this->FindCycle(true, row, other, column);
+            }
+            else if (kind == 1) {
+                other += (other >= column);
+                this->FindCycle(false, column, other, row);
+            } else {
+                other += (other >= this->Mult(row, column));
+                this->FindSymbolCycle(row, column, other);
+            }
+
+            /*
+                The affected triples: those using a changed cell. The
+                same before and after the swap: the cells (a, b) and
+                (b, c) of a triple are fixed, and (ab, c) or (a, bc)
+                can only move if (a, b) or (b, c) is a changed cell.
+            */
+            this->stamp++;
+            this->affected.clear();
+
+            if (this->stamp == 0) {
+                std::fill(this->stamps.begin(), this->stamps.end(), 0);
+                this->stamp = 1;
+            }
+
+            for(int changed : this->changedCells) {
+                this->CollectTriples(changed / n, changed % n);
+            }
+
+            int before = this->CountAffected();
+            this->Swap();
+            int after = this->CountAffected();
+            int delta = after - before;
+            this->moves++;
+
+            bool accept = delta <= 0 || std::uniform_real_distribution<double>(0, 1)(this->random)
+                < exp(-delta / this->temperature);
+
+            this->temperature *= this->cooling;
+
+            if (this->temperature < 0.01) {
+                this->temperature = this->initialTemperature;
+            }
+
+            if (!accept) {
+                this->Swap();
+                return;
+            }
+
+            /*
+                Update the counts of the cells.
+            */
+            this->accepted++;
+            this->violations += delta;
+
+            for(uint32_t triple : this->affected) {
+                if (this->IsViolated(triple)) {
+                    this->CountCells(triple, 1);
+                }
+            }
+
+            this->Swap();
+
+            for(uint32_t triple : this->affected) {
+                if (this->IsViolated(triple)) {
+                    this->CountCells(triple, -1);
+                }
+            }
+
+            this->Swap();
+        }
+
+    public:
+        /**
+         * @brief Starts from a random Latin square.
+         */
+        LocalSearch(int order, uint64_t seed)
+            : order(order), random(seed), stamp(0), violations(0), moves(0), accepted(0),
+              initialTemperature(10.0), temperature(10.0), cooling(0.99999) {
+
+            if (order < 1 || order > 127) {
+                throw std::runtime_error("Invalid order value. Allowed: 1 -> 127");
+            }
+
+            int n = order;
+            JacobsonMatthews sampler(n, seed);
+            const uint8_t *square = sampler.Next((uint64_t)n * n, false);
+
+            this->table.resize(n * n);
+            this->rowColumn.resize(n * n);
+            this->columnRow.resize(n * n);
+            this->cayley.resize(n * n);
+            this->cellViolations.assign(n * n, 0);
+            this->stamps.assign(n * n * n, 0);
+
+            for(int i = 0; i < n * n; i++) {
+                this->Put(i / n, i % n, square[i] - 1);
+            }
+
+            this->violations = this->CountViolations();
+        }
+
+        /**
+         * @param initial Starting temperature. (Restarts from it when it drops below 0.01.)
+         * @param cooling Multiplier of the temperature after each move.
+         */
+        void SetAnnealing(double initial, double cooling) {
+            if (initial <= 0.01 || cooling <= 0 || cooling >= 1) {
+                throw std::runtime_error("Invalid annealing parameters.");
+            }
+
+            this->initialTemperature = initial;
+            this->temperature = initial;
+            this->cooling = cooling;
+        }
+
+        /**
+         * @brief Counts the violated triples from scratch, and sets the
+         * counts of the cells. O(n^3)
+         */
+        uint64_t CountViolations() {
+            int n = this->order;
+            uint64_t count = 0;
+            std::fill(this->cellViolations.begin(), this->cellViolations.end(), 0);
+
+            for(uint32_t triple = 0; triple < (uint32_t)(n * n * n); triple++) {
+                if (this->IsViolated(triple)) {
+                    this->CountCells(triple, 1);
+                    count++;
+                }
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief Runs until a group is found or the moves run out.
+         * @return True if a group was found.
+         */
+        bool Run(uint64_t maxMoves) {
+            for(uint64_t i = 0; i < maxMoves && this->violations > 0; i++) {
+                this->Move();
+            }
+
+            return this->violations == 0;
+        }
+
+        uint64_t GetViolations() const {
+            return this->violations;
+        }
+
+        uint64_t GetMoveCount() const {
+            return this->moves;
+        }
+
+        uint64_t GetAcceptedCount() const {
+            return this->accepted;
+        }
+
+        /**
+         * @brief The table in the 1-based format of the other modules.
+         * When a group was found, the elements are relabelled, so that
+         * the identity is 1.
+         */
+        uint8_t* GetCayley() {
+            int n = this->order;
+            int identity = 0;
+
+            for(int e = 0; e < n; e++) {
+                if (this->Mult(e, e) == e) {
+                    identity = e;
+                    break;
+                }
+            }
+
+            /*
+                Swap the labels of the identity and 0.
+            */
+            auto label = [identity](int x) { return x == identity ? 0 : (x == 0 ? identity : x); };
+
+            for(int a = 0; a < n; a++) {
+                for(int b = 0; b < n; b++) {
+                    this->cayley[label(a) * n + label(b)] = label(this->Mult(a, b)) + 1;
+                }
+            }
+
+            return &this->cayley[0];
+        }
+};
@@ -0,0 +1,283 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <string.h>
+#include <stdexcept>
+
+/**
+ * @brief Bounded memory of failures (nogoods): small sets of
+ * (cell, value) assignments which can't be extended to a group.
+ * Works like the transposition table of a chess engine.
+ *
+ * A literal is stored as (position << 5) | (value - 1), so the
+ * order is limited to 32. Each nogood is watched by its deepest
+ * literal. In a static visit order all other literals are already
+ * assigned when the watched cell is tried, so a single watch is
+ * enough: Find() only checks the nogoods of the candidate literal.
+ *
+ * Every watched literal has its own watch list: a block of the
+ * entry pool, in most recently used order. A full list drops its
+ * least recently used nogood. The length of the lists is bounded
+ * (see GetWatchLimit()), so Find() stays cheap, and the pool is
+ * shared by the literals: when no block is free, a clock (second
+ * chance) sweep over the blocks chooses the list to drop.
+ */
+class NogoodCache {
+    public:
+        static const int MaxLength = 8;     // Longer nogoods are not stored.
+        static const int MinWatch = 8;      // Bounds of the watch list length.
+        static const int MaxWatch = 32;
+
+    private:
+        static const uint32_t None = 0xFFFFFFFFU;
+
+        struct Entry {
+            uint8_t length;                 // Number of the other literals.
+            uint8_t unused;
+            uint16_t literals[MaxLength - 1];
+        };
+
+        struct Block {
+            uint32_t watched;               // Owner literal. (None: free)
+            uint16_t size;
+            uint8_t referenced;             // Used since the last sweep. (Clock)
+            uint8_t unused;
+        };
+
+        Entry *entries;                     // blockCount * watchLimit
+        Block *blocks;
+        uint32_t blockCount;
+        uint32_t usedBlocks;                // Blocks taken from the pool.
+        uint32_t hand;                      // Position of the clock sweep.
+        uint32_t *lists;                    // Per literal: block index or None.
+        int literalCount;
+        int watchLimit;
+
+        uint64_t lookups;
+        uint64_t hits;
+        uint64_t inserts;
+        uint64_t evictions;
+        uint64_t tooLong;
+
+        /**
+         * @brief The block of a new watch list: a free one, or the
+         * first one without use since the previous pass of the clock.
+         */
+        uint32_t TakeBlock(uint16_t watched) {
+            uint32_t index;
+
+            if (this->usedBlocks < this->blockCount) {
+                index = this->usedBlocks++;
+            } else {
+                while(true) {
+                    index = this->hand;
+                    this->hand = this->hand + 1 == this->blockCount ? 0 : this->hand + 1;
+
+                    if (!this->blocks[index].referenced) {
+                        break;
+                    }
+
+                    this->blocks[index].referenced = 0;
+                }
+
+                Block &victim = this->blocks[index];
+                this->lists[victim.watched] = None;
+                this->evictions += victim.size;
+            }
+
+            Block &block = this->blocks[index];
+            block.watched = watched;
+            block.size = 0;
+            block.referenced = 1;
+            this->lists[watched] = index;
+
+            return index;
+        }
+
+    public:
+        /**
+         * @param capacity Maximal number of nogoods.
+         * @param order Order of the tables. (Size of the literal space)
+         */
+        NogoodCache(int capacity, int order) : lookups(0), hits(0), inserts(0), evictions(0), tooLong(0) {
+            if (capacity < MinWatch) {
+                throw std::runtime_error("NogoodCache: the capacity must be at least "
+                    + std::to_string(MinWatch) + ".");
+            }
+
+            if (order < 1 || order > 32) {
+                throw std::runtime_error("NogoodCache: invalid order value. Allowed: 1 -> 32");
+            }
+
+            /*
+                A few times the average share of a literal (order^3 of
+                them), since most literals never fail.
+            */
+            int64_t share = 4 * (int64_t)capacity / (order * order * order);
+            this->watchLimit = (int)std::min<int64_t>(MaxWatch, std::max<int64_t>(MinWatch, share));
+            this->blockCount = capacity / this->watchLimit;
+            this->literalCount = order * order * 32;
+
+            this->entries = new Entry[this->blockCount * this->watchLimit];
+            this->blocks = new Block[this->blockCount];
+            this->lists = new uint32_t[this->literalCount];
+            this->Clear();
+        }
+
+        ~NogoodCache() {
+            delete[] this->entries;
+            delete[] this->blocks;
+            delete[] this->lists;
+        }
+
+        static inline uint16_t Literal(int pos, int value) {
+            return (pos << 5) | (value - 1);
+        }
+
+        static inline int LiteralPos(uint16_t literal) {
+            return literal >> 5;
+        }
+
+        /**
+         * @brief Looks for a stored nogood, which becomes complete
+         * if "value" is put into the cell at "pos".
+         *
+         * @param length Output: the number of the other literals.
+         * @return The other literals of the nogood, or nullptr.
+         */
+        inline const uint16_t* Find(int pos, int value, const uint8_t *cayley, int &length) {
+            uint32_t index = this->lists[NogoodCache::Literal(pos, value)];
+            this->lookups++;
+
+            if (index == None) {
+                return nullptr;
+            }
+
+            Block &block = this->blocks[index];
+            Entry *list = this->entries + index * this->watchLimit;
+
+            for(int e = 0; e < block.size; e++) {
+                for(int i = 0; i < list[e].length; i++) {
+                    uint16_t literal = list[e].literals[i];
+
+                    if (cayley[literal >> 5] != (literal & 31) + 1) {
+                        goto nextEntry;
+                    }
+                }
+
+                /*
+                    Move to the front.
+                */
+                if (e > 0) {
+                    Entry hit = list[e];
+                    memmove(list + 1, list, e * sizeof(Entry));
+                    list[0] = hit;
+                }
+
+                this->hits++;
+                block.referenced = 1;
+                length = list[0].length;
+
+                return list[0].literals;
+
+                nextEntry: ;
+            }
+
+            return nullptr;
+        }
+
+        /**
+         * @brief Stores a nogood.
+         *
+         * @param watched The deepest literal.
+         * @param literals The other literals.
+         * @param length The number of the other literals.
+         */
+        void Insert(uint16_t watched, const uint16_t *literals, int length) {
+            if (length > MaxLength - 1) {
+                this->tooLong++;
+                return;
+            }
+
+            uint32_t index = this->lists[watched];
+
+            if (index == None) {
+                index = this->TakeBlock(watched);
+            }
+
+            Block &block = this->blocks[index];
+            Entry *list = this->entries + index * this->watchLimit;
+
+            if (block.size == this->watchLimit) {
+                block.size--;
+                this->evictions++;
+            }
+
+            memmove(list + 1, list, block.size * sizeof(Entry));
+            list[0].length = length;
+            memcpy(list[0].literals, literals, length * sizeof(uint16_t));
+            block.size++;
+            block.referenced = 1;
+            this->inserts++;
+        }
+
+        /**
+         * @brief Counts a nogood which was not stored, because it has
+         * more than MaxLength literals.
+         */
+        void CountTooLong() {
+            this->tooLong++;
+        }
+
+        void Clear() {
+            for(int i = 0; i < this->literalCount; i++) {
+                this->lists[i] = None;
+            }
+
+            this->usedBlocks = 0;
+            this->hand = 0;
+        }
+
+        uint64_t GetHits() const {
+            return this->hits;
+        }
+
+        /**
+         * @brief Maximal length of the watch list of a literal.
+         */
+        int GetWatchLimit() const {
+            return this->watchLimit;
+        }
+
+        void PrintStats(std::ostream &output) const {
+            uint64_t stored = 0;
+
+            for(uint32_t i = 0; i < this->usedBlocks; i++) {
+                stored += this->blocks[i].size;
+            }
+
+            output << "Nogoods: " << this->inserts << " stored, " << this->evictions << " evicted, "
+                << this->tooLong << " too long, " << stored << " in the cache (" << this->usedBlocks << " / "
+                << this->blockCount << " watch lists of " << this->watchLimit << "). Lookups: " << this->lookups
+                << ", hits: " << this->hits << " (" << (this->lookups ? 100.0 * this->hits / this->lookups : 0.0)
+                << "%)\n";
+        }
+};
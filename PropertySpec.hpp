@@ -0,0 +1,139 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <stdlib.h>
+#include <stdexcept>
+
+/**
+ * @brief Properties required from the groups of a search. The search
+ * enforces them on the partial tables, so the branches which can't
+ * lead to such a group are cut early. (See AssocHeuristics.)
+ *
+ * Text format: comma separated list of
+ *      nonabelian
+ *      involutions=<min>..<max>    (or a single number)
+ *      exponent=<e>                Every element order divides e.
+ *      center=<min>..<max>         (or a single number)
+ */
+class PropertySpec {
+    public:
+        bool nonAbelian;
+        int minInvolutions;     // Elements of order 2.
+        int maxInvolutions;     // -1: no limit
+        int exponent;           // 0: no limit
+        int minCenter;
+        int maxCenter;          // -1: no limit
+
+        PropertySpec() : nonAbelian(false), minInvolutions(0), maxInvolutions(-1), exponent(0),
+            minCenter(1), maxCenter(-1) { }
+
+        bool IsEmpty() const {
+            return !this->nonAbelian && this->minInvolutions == 0 && this->maxInvolutions < 0
+                && this->exponent == 0 && this->minCenter <= 1 && this->maxCenter < 0;
+        }
+
+        bool HasInvolutionBounds() const {
+            return this->minInvolutions > 0 || this->maxInvolutions >= 0;
+        }
+
+        bool HasCenterBounds() const {
+            return this->minCenter > 1 || this->maxCenter >= 0;
+        }
+
+        static PropertySpec Parse(const std::string &text) {
+            PropertySpec spec;
+            std::stringstream input(text);
+            std::string item;
+
+            while(std::getline(input, item, ',')) {
+                std::string key = item.substr(0, item.find('='));
+                std::string value = item.find('=') == std::string::npos ? "" : item.substr(item.find('=') + 1);
+
+                if (key == "nonabelian" && value.empty()) {
+                    spec.nonAbelian = true;
+                }
+                else if (key == "involutions" && !value.empty()) {
+                    PropertySpec::ParseRange(value, spec.minInvolutions, spec.maxInvolutions);
+                }
+                else if (key == "exponent" && !value.empty()) {
+                    spec.exponent = atoi(value.c_str());
+
+                    if (spec.exponent < 1) {
+                        throw std::runtime_error("Invalid exponent: " + value);
+                    }
+                }
+                else if (key == "center" && !value.empty()) {
+                    PropertySpec::ParseRange(value, spec.minCenter, spec.maxCenter);
+                }
+                else if (!item.empty()) {
+                    throw std::runtime_error("Unknown property: " + item);
+                }
+            }
+
+            return spec;
+        }
+
+        std::string ToString() const {
+            std::stringstream result;
+
+            if (this->nonAbelian) {
+                result << "nonabelian,";
+            }
+
+            if (this->HasInvolutionBounds()) {
+                result << "involutions=" << this->minInvolutions << ".."
+                    << (this->maxInvolutions < 0 ? std::string("") : std::to_string(this->maxInvolutions)) << ',';
+            }
+
+            if (this->exponent > 0) {
+                result << "exponent=" << this->exponent << ',';
+            }
+
+            if (this->HasCenterBounds()) {
+                result << "center=" << this->minCenter << ".."
+                    << (this->maxCenter < 0 ? std::string("") : std::to_string(this->maxCenter)) << ',';
+            }
+
+            std::string text = result.str();
+
+            return text.empty() ? text : text.substr(0, text.size() - 1);
+        }
+
+    private:
+        /**
+         * @brief "3", "1..4", "2.." (no upper limit) or "..5".
+         */
+        static void ParseRange(const std::string &text, int &min, int &max) {
+            size_t dots = text.find("..");
+
+            if (dots == std::string::npos) {
+                min = max = atoi(text.c_str());
+            } else {
+                std::string low = text.substr(0, dots);
+                std::string high = text.substr(dots + 2);
+
+                min = low.empty() ? min : atoi(low.c_str());
+                max = high.empty() ? -1 : atoi(high.c_str());
+            }
+
+            if (min < 0 || (max >= 0 && max < min)) {
+                throw std::runtime_error("Invalid range: " + text);
+            }
+        }
+};
@@ -23,6 +23,11 @@
 #include <iomanip>
 #include <sstream>
 #include <string.h>
+#include <vector>
+#include "SearchArena.hpp"
+#include "SearchTrail.hpp"
+#include "SearchBudget.hpp"
+#include "TableWriter.hpp"
 
 /**
  * @brief Find groups. Same as AssocHeuristic, but the search is randomized.
@@ -32,48 +37,46 @@ class RandomHeuristics {
         int order;
         int size;
         uint8_t *cayley;         // Cayley table
-        uint32_t *track;         // Bitmaps of already used values.
+        SearchArena arena;       // The memory of the arrays.
+        SearchTrail trail;       // Assignment stack and undo log.
+        SearchTrail::Frame *frames;
         uint32_t *rowValues;     // Bitmaps of currently used values in rows.
         uint32_t *columnValues;  // Bitmaps of currently used values in columns.
         int x;
         int y;
         int pos;
+        int depth;               // Index of the current frame.
         bool found;
         unsigned int seed;
         uint32_t orderMask;
         int progress;
         
+        inline void LoadFrame() {
+            this->pos = this->frames[this->depth].pos;
+            this->x = this->frames[this->depth].x;
+            this->y = this->frames[this->depth].y;
+        }
+
         inline bool StepForward() {
-            if (this->x >= this->order - 1) {
-                if (this->y >= this->order - 1) {
-                    return false;
-                }
-                
-                this->x = 1;
-                this->y++;
-                this->pos += 2;
-            } else {
-                this->x++;
-                this->pos++;
+            if (this->depth >= this->trail.GetFrameCount() - 1) {
+                return false;
             }
 
+            this->depth++;
+            this->trail.Enter(this->depth);
+            this->LoadFrame();
+
             return true;
         }
 
         inline bool StepBackward() {
-            if (this->x <= 1) {
-                if (this->y <= 1) {
-                    return false;
-                }
-                
-                this->x = this->order - 1;
-                this->y--;
-                this->pos -= 2;
-            } else {
-                this->x--;
-                this->pos--;
+            if (this->depth <= 0) {
+                return false;
             }
 
+            this->depth--;
+            this->LoadFrame();
+
             return true;
         }
 
@@ -82,9 +85,9 @@ class RandomHeuristics {
             uint32_t bit = ((uint32_t)1) << normalValue;
 
             this->cayley[this->pos] = value;
-            this->track[this->pos] |= bit;
-            this->rowValues[this->y] |= bit;
-            this->columnValues[this->x] |= bit;
+            this->frames[this->depth].tried |= bit;
+            this->trail.Or(this->y, bit);
+            this->trail.Or(this->order + this->x, bit);
 
             /*if (this->pos > this->progress) {
                 std::cout << std::setprecision(2);
@@ -94,31 +97,18 @@ class RandomHeuristics {
 
             /*std::cout << "Columns[4]: " << std::bitset<32>(this->columnValues[4]) << '\n';
             std::cout << "Rows[1]: " << std::bitset<32>(this->rowValues[1]) << '\n';
-            std::cout << "Track[9]: " << std::bitset<32>(this->track[9]) << '\n';
+            std::cout << "Tried: " << std::bitset<32>(this->frames[this->depth].tried) << '\n';
             */
             // std::cout << this->GetAsText(true) << '\n';
         }
 
-        inline void Unset(bool isBackTracking) {
-            if (isBackTracking) {
-                this->track[this->pos] = 0;
-            }
-
-            uint8_t value = this->cayley[this->pos];
-            if (value == 0) {
-                // Nothing to unset
-                // std::cout << this->GetAsText(true) << '\n';
-                return;
-            }
-
-            uint8_t normalValue = value - 1;
-            uint32_t bit = ~(((uint32_t)1) << normalValue);
-
+        /**
+         * @brief Clears the cell of the current frame and undoes
+         * the changes of its assignment. The tried values are kept.
+         */
+        inline void Unset() {
             this->cayley[this->pos] = 0;
-            this->rowValues[this->y] &= bit;
-            this->columnValues[this->x] &= bit;
-
-            // std::cout << this->GetAsText(true) << '\n';
+            this->trail.Undo(this->frames[this->depth].mark);
         }
 
         inline uint8_t Mult(uint8_t a, uint8_t b) {
@@ -127,10 +117,11 @@ class RandomHeuristics {
 
         inline int FindPossibleValue() {
             uint8_t oldValue = this->cayley[this->pos];
+            uint32_t &tried = this->frames[this->depth].tried;
 
             start_find:
             
-            uint32_t bitMap = this->orderMask & ~(this->track[this->pos] | this->rowValues[this->y]
+            uint32_t bitMap = this->orderMask & ~(tried | this->rowValues[this->y]
                 | this->columnValues[this->x]);
             
             if (bitMap == 0) {
@@ -182,7 +173,7 @@ class RandomHeuristics {
                 }
 
                 if (left != right) {
-                    this->track[this->pos] |= ((uint32_t)1) << normalValue;
+                    tried |= ((uint32_t)1) << normalValue;
                     goto start_find;
                 }
 
@@ -207,7 +198,7 @@ class RandomHeuristics {
                 }
 
                 if (left != right) {
-                    this->track[this->pos] |= ((uint32_t)1) << normalValue;
+                    tried |= ((uint32_t)1) << normalValue;
                     goto start_find;
                 }
             }
@@ -223,41 +214,59 @@ class RandomHeuristics {
             while(this->StepBackward()) {
                 next = this->FindPossibleValue();
                 if (next <= this->order) {
-                    this->Unset(false);
+                    this->Unset();
                     return next;
                 }
 
-                this->Unset(true);
+                this->Unset();
             }
 
             return this->order + 1;
         }
 
     public:
-        RandomHeuristics(uint8_t order, unsigned int seed) {
+        /**
+         * @brief Size of the arena of an engine: the undo log, the bitmaps,
+         * the frames and the table, then the snapshot of the last three.
+         */
+        static size_t ArenaBytes(int order) {
             if (order < 2 || order > 31) {
                 throw std::runtime_error("Invalid order value. Allowed: 2 -> 31");
             }
-            
+
+            int frameCount = (order - 1) * (order - 1);
+            size_t state = SearchTrail::StateBytes(2 * order, frameCount) + SearchArena::Bytes<uint8_t>(order * order);
+
+            return SearchTrail::ArenaBytes(2 * order, frameCount) + SearchArena::Bytes<uint8_t>(order * order) + state;
+        }
+
+        RandomHeuristics(uint8_t order, unsigned int seed)
+            : arena(RandomHeuristics::ArenaBytes(order)), trail(2 * order, (order - 1) * (order - 1), arena) {
+
             this->order = order;
             this->orderMask = (((uint32_t)1) << order) - 1;
             this->size = order * order;
-            this->cayley = new uint8_t[this->size];
-            this->track = new uint32_t[this->size];
-            this->rowValues = new uint32_t[order];
-            this->columnValues = new uint32_t[order];
-            this->x = 1;
-            this->y = 1;
-            this->pos = this->order + 1;
+            this->cayley = this->arena.Take<uint8_t>(this->size);
+            this->arena.MarkSnapshot(this->trail.GetMasks());
+            this->frames = this->trail.GetFrames();
+            this->rowValues = this->trail.GetMasks();
+            this->columnValues = this->rowValues + order;
+            this->depth = 0;
             this->found = false;
             this->seed = seed;
             srand(seed);
             this->progress = 0;
 
-            memset(this->cayley, 0, this->size * sizeof(uint8_t));
-            memset(this->track, 0, this->size * sizeof(uint32_t));
-            memset(this->rowValues, 0, order * sizeof(uint32_t));
-            memset(this->columnValues, 0, order * sizeof(uint32_t));
+            /*
+                Visit order: the free cells in raster order.
+            */
+            for(int d = 0; d < this->trail.GetFrameCount(); d++) {
+                int y = 1 + d / (order - 1);
+                int x = 1 + d % (order - 1);
+                this->trail.SetFrameCell(d, y * order + x, x, y);
+            }
+
+            this->LoadFrame();
 
             /*
                 Fixed values
@@ -275,13 +284,21 @@ class RandomHeuristics {
                 *(this->cayley + i * this->order) = i + 1;
                 this->rowValues[i] |= 1 << i;
             }
+
+            this->arena.SaveSnapshot();
         }
 
-        ~RandomHeuristics() {
-            delete[] this->cayley;
-            delete[] this->track;
-            delete[] this->rowValues;
-            delete[] this->columnValues;
+        /**
+         * @brief Returns to the initial state with one copy of the arrays
+         * from their snapshot. The seed is kept.
+         */
+        void Reset() {
+            this->arena.RestoreSnapshot();
+            this->trail.ClearLog();
+            this->depth = 0;
+            this->LoadFrame();
+            this->found = false;
+            this->progress = 0;
         }
 
         /**
@@ -291,41 +308,25 @@ class RandomHeuristics {
             time_t t;
             this->seed ^= rand() ^ time(&t);
             srand(this->seed);
-
-            memset(this->cayley, 0, this->size * sizeof(uint8_t));
-            memset(this->track, 0, this->size * sizeof(uint32_t));
-            memset(this->rowValues, 0, order * sizeof(uint32_t));
-            memset(this->columnValues, 0, order * sizeof(uint32_t));
-
-            this->x = 1;
-            this->y = 1;
-            this->pos = this->order + 1;
-            this->found = false;
-            this->progress = 0;
-
-            /*
-                Fixed values
-            */
-            for(int i = 0; i < this->order; i++) {
-                /*
-                    Horizontal
-                */
-                *(this->cayley + i) = i + 1;
-                this->columnValues[i] |= 1 << i;
-
-                /*
-                    Vertical
-                */
-                *(this->cayley + i * this->order) = i + 1;
-                this->rowValues[i] |= 1 << i;
-            }
+            this->Reset();
         }
 
-        bool Next() {
+    private:
+        /**
+         * @brief The search loop of Next(). With a budget, it can stop at
+         * the start of a node: the state is the same as before visiting it,
+         * so the next call continues from there.
+         */
+        SearchStatus Search(SearchBudget *budget) {
             int next;
+            uint64_t visited = 0;
             this->found = false;
 
             do {
+                if (budget != nullptr && budget->IsExhausted(visited++)) {
+                    return SearchStatus::BudgetExhausted;
+                }
+
                 /*
                     Search for a possible value
                 */
@@ -335,14 +336,14 @@ class RandomHeuristics {
                     /*
                         No value left to be tried => backtracking
                     */
-                    this->Unset(true);
+                    this->Unset();
                     next = this->BackTracking();
                     if (next > this->order) {
-                        return false;
+                        return SearchStatus::Finished;
                     }
                 }
 
-                this->Unset(false);
+                this->Unset();
                 this->Set(next);
 
                 //std::cin.get();
@@ -351,36 +352,56 @@ class RandomHeuristics {
 
             this->found = true;
 
-            if (next > this->order) {
-                // Last one
-                return false;
-            }
+            return SearchStatus::Found;
+        }
 
-            // More to be expected
-            return true;
+    public:
+        /**
+         * @return True if a table was found. (Check Found() too.)
+         */
+        bool Next() {
+            return this->Search(nullptr) == SearchStatus::Found;
+        }
+
+        /**
+         * @brief Next() within the limits of the budget. After
+         * BudgetExhausted, call it again to continue.
+         */
+        SearchStatus Next(SearchBudget &budget) {
+            return this->Search(&budget);
         }
 
         std::string GetAsText(bool showTrack = false) {
-            std::stringstream result;
+            TableWriter writer;
+
+            if (!showTrack) {
+                writer.WriteTable(this->order, this->cayley);
+                return writer.ToString();
+            }
+
+            std::vector<uint32_t> track(this->size, 0);
+
+            for(int d = 0; d <= this->depth; d++) {
+                track[this->frames[d].pos] = this->frames[d].tried;
+            }
 
             for(int i = 0; i < this->order; i++) {
                 for(int j = 0; j < this->order; j++) {
-                    result << std::setfill('0') << std::setw(2)
-                        << (int)(*(this->cayley + j + i * this->order)) << ";";
+                    writer.AppendPadded(this->cayley[j + i * this->order]);
+                    writer.Append(';');
                 }
 
-                if (showTrack) {
-                    result << "    ";
+                writer.Append("    ", 4);
 
-                    for(int j = 0; j < this->order; j++) {
-                        result << std::bitset<8>(this->track[j + i * this->order]) << ";";
-                    }
+                for(int j = 0; j < this->order; j++) {
+                    writer.AppendBits(track[j + i * this->order], 8);
+                    writer.Append(';');
                 }
-                
-                result << '\n';
+
+                writer.Append('\n');
             }
 
-            return result.str();
+            return writer.ToString();
         }
 
         bool Found() {
@@ -0,0 +1,135 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <stdexcept>
+
+/**
+ * @brief One memory block for all arrays of a search engine, instead of
+ * a new[] for each. The arrays are taken one after the other, each one
+ * aligned to a cache line (64 bytes).
+ *
+ * Snapshot: the arrays taken between MarkSnapshot() and the call of
+ * SaveSnapshot() are copied to the end of the block, and
+ * RestoreSnapshot() copies them back with one memcpy. The engines take
+ * the arrays which are reset between searches first, so a reset is
+ * a single bulk copy.
+ *
+ * The size of the block is fixed: the engines compute it with Bytes()
+ * (including the space of the snapshot) before taking the arrays.
+ */
+class SearchArena {
+    private:
+        uint8_t *block;
+        size_t capacity;
+        size_t used;
+        size_t snapshotBegin;
+        size_t snapshotSize;
+        uint8_t *snapshot;
+
+    public:
+        static const size_t lineSize = 64;
+
+        /**
+         * @brief The space taken by an array, rounded up to full cache lines.
+         */
+        template<typename T>
+        static size_t Bytes(size_t count) {
+            return (count * sizeof(T) + lineSize - 1) & ~(lineSize - 1);
+        }
+
+        /**
+         * @brief Allocates the zero filled block.
+         */
+        explicit SearchArena(size_t capacity)
+            : block(nullptr), capacity(capacity), used(0), snapshotBegin(0), snapshotSize(0), snapshot(nullptr) {
+
+            void *memory = nullptr;
+
+            if (posix_memalign(&memory, lineSize, capacity > 0 ? capacity : lineSize) != 0) {
+                throw std::bad_alloc();
+            }
+
+            this->block = (uint8_t *)memory;
+            memset(this->block, 0, capacity);
+        }
+
+        ~SearchArena() {
+            free(this->block);
+        }
+
+        SearchArena(const SearchArena &) = delete;
+        SearchArena& operator=(const SearchArena &) = delete;
+
+        /**
+         * @brief The next array of the block. (Zero filled)
+         */
+        template<typename T>
+        T* Take(size_t count) {
+            size_t bytes = SearchArena::Bytes<T>(count);
+
+            if (this->used + bytes > this->capacity) {
+                throw std::runtime_error("SearchArena: the block is too small.");
+            }
+
+            T *array = (T *)(this->block + this->used);
+            this->used += bytes;
+
+            return array;
+        }
+
+        /**
+         * @brief The snapshot contains the arrays from "begin" (an array
+         * of the block) to the last one taken. Takes the space of the copy.
+         */
+        void MarkSnapshot(const void *begin) {
+            this->snapshotBegin = (const uint8_t *)begin - this->block;
+            this->snapshotSize = this->used - this->snapshotBegin;
+            this->snapshot = this->Take<uint8_t>(this->snapshotSize);
+        }
+
+        void SaveSnapshot() {
+            memcpy(this->snapshot, this->block + this->snapshotBegin, this->snapshotSize);
+        }
+
+        void RestoreSnapshot() {
+            memcpy(this->block + this->snapshotBegin, this->snapshot, this->snapshotSize);
+        }
+
+        /**
+         * @brief Copies the current arrays of the snapshot into a buffer
+         * of GetSnapshotSize() bytes, without changing the snapshot.
+         */
+        void CopySnapshotArrays(uint8_t *to) const {
+            memcpy(to, this->block + this->snapshotBegin, this->snapshotSize);
+        }
+
+        void LoadSnapshotArrays(const uint8_t *from) {
+            memcpy(this->block + this->snapshotBegin, from, this->snapshotSize);
+        }
+
+        size_t GetCapacity() const {
+            return this->capacity;
+        }
+
+        size_t GetSnapshotSize() const {
+            return this->snapshotSize;
+        }
+};
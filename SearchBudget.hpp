@@ -0,0 +1,103 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+/**
+ * @brief Result of a Next() call with a budget.
+ */
+enum class SearchStatus {
+    Found,              // A table was found. (Call Next() again for more.)
+    Finished,           // The whole tree was searched.
+    BudgetExhausted     // Stopped by the budget. The next call continues from the same point.
+};
+
+/**
+ * @brief Limits of one Next() call: a node budget, a deadline and a
+ * cancellation flag, which can be set from another thread.
+ *
+ * The engines call IsExhausted() once per node. It reads the flag with
+ * a relaxed load, and the clock only at every 1024th node, so it costs
+ * a few instructions.
+ */
+class SearchBudget {
+    private:
+        uint64_t nodeLimit;                     // 0: no limit
+        bool hasDeadline;
+        std::chrono::steady_clock::time_point deadline;
+        const std::atomic<bool> *cancel;
+        uint32_t counter;
+
+    public:
+        SearchBudget() : nodeLimit(0), hasDeadline(false), cancel(nullptr), counter(0) { }
+
+        /**
+         * @brief Maximal number of nodes in one call. (0: no limit)
+         */
+        void SetNodeLimit(uint64_t nodes) {
+            this->nodeLimit = nodes;
+        }
+
+        void SetDeadline(std::chrono::steady_clock::time_point deadline) {
+            this->hasDeadline = true;
+            this->deadline = deadline;
+        }
+
+        /**
+         * @brief Deadline in seconds from now.
+         */
+        void SetTimeLimit(double seconds) {
+            this->SetDeadline(std::chrono::steady_clock::now()
+                + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(seconds)));
+        }
+
+        /**
+         * @brief The search stops when the flag becomes true. (The flag
+         * must outlive the budget.)
+         */
+        void SetCancelFlag(const std::atomic<bool> *flag) {
+            this->cancel = flag;
+        }
+
+        /**
+         * @param nodes Nodes visited in the current call.
+         */
+        inline bool IsExhausted(uint64_t nodes) {
+            if (this->cancel != nullptr && this->cancel->load(std::memory_order_relaxed)) {
+                return true;
+            }
+
+            if (this->nodeLimit > 0 && nodes >= this->nodeLimit) {
+                return true;
+            }
+
+            if (this->hasDeadline && (++this->counter & 1023) == 0
+                && std::chrono::steady_clock::now() >= this->deadline) {
+
+                return true;
+            }
+
+            return false;
+        }
+
+        bool IsCancelled() const {
+            return this->cancel != nullptr && this->cancel->load(std::memory_order_relaxed);
+        }
+};
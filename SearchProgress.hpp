@@ -0,0 +1,170 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+
+/**
+ * @brief Periodic progress report of a long search: nodes per second,
+ * the completed part of the tree, the estimated remaining nodes and
+ * the ETA. One line per report, so it can go to stderr or a file.
+ *
+ * The engine calls Report() every few thousand nodes (see
+ * AssocHeuristics::SetProgress()). Only the clock is read then,
+ * a line is printed when the interval has passed.
+ *
+ * Two estimates of the remaining work are shown:
+ *  - From the completed fraction of the tree, which the engine computes
+ *    from the values already tried on the current path. Each completed
+ *    sibling subtree is counted with the same weight.
+ *  - From the total size estimated by random probing (Knuth's
+ *    estimator), if it was set. With SetReestimation() the engine
+ *    probes again from the current node periodically.
+ */
+class SearchProgress {
+    private:
+        std::ostream &output;
+        double interval;
+        double estimate;
+        double estimateInterval;    // Seconds between two estimates. (0: no re-estimation)
+        int estimateProbes;
+        bool estimateDue;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point last;
+        std::chrono::steady_clock::time_point lastEstimate;
+        uint64_t lastNodes;
+
+        static void PrintDuration(std::ostream &output, double seconds) {
+            if (seconds < 0 || seconds > 1e12) {
+                output << '?';
+                return;
+            }
+
+            uint64_t total = (uint64_t)seconds;
+            uint64_t days = total / 86400;
+
+            if (days > 0) {
+                output << days << "d ";
+            }
+
+            output << (total / 3600) % 24 << "h " << (total / 60) % 60 << "m " << total % 60 << 's';
+        }
+
+    public:
+        /**
+         * @param interval Seconds between two reports.
+         */
+        SearchProgress(std::ostream &output, double interval)
+            : output(output), interval(interval), estimate(0), estimateInterval(0), estimateProbes(0),
+              estimateDue(false), lastNodes(0) {
+
+            this->start = std::chrono::steady_clock::now();
+            this->last = this->start;
+            this->lastEstimate = this->start;
+        }
+
+        /**
+         * @brief The estimated size of the whole tree in nodes.
+         */
+        void SetEstimate(double nodes) {
+            this->estimate = nodes;
+            this->lastEstimate = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * @brief Asks the engine for a new estimate by probing from
+         * the current node every "interval" seconds.
+         *
+         * @param probes Probes per frame of the path.
+         */
+        void SetReestimation(double interval, int probes) {
+            this->estimateInterval = interval;
+            this->estimateProbes = probes;
+        }
+
+        /**
+         * @brief True once after each re-estimation interval. The engine
+         * checks it where the search can be interrupted, and calls
+         * SetEstimate() with the nodes so far plus the remaining ones.
+         */
+        bool IsEstimateDue() {
+            bool due = this->estimateDue;
+            this->estimateDue = false;
+
+            return due;
+        }
+
+        int GetEstimateProbes() const {
+            return this->estimateProbes;
+        }
+
+        /**
+         * @param nodes Nodes visited so far.
+         * @param done Completed fraction of the tree. (0 -> 1)
+         * @param force Print even if the interval hasn't passed yet.
+         */
+        void Report(uint64_t nodes, double done, bool force = false) {
+            auto now = std::chrono::steady_clock::now();
+            double sinceLast = std::chrono::duration<double>(now - this->last).count();
+
+            if (this->estimateInterval > 0
+                && std::chrono::duration<double>(now - this->lastEstimate).count() >= this->estimateInterval) {
+
+                this->estimateDue = true;
+            }
+
+            if (!force && sinceLast < this->interval) {
+                return;
+            }
+
+            double elapsed = std::chrono::duration<double>(now - this->start).count();
+            double rate = sinceLast > 0 ? (nodes - this->lastNodes) / sinceLast : 0.0;
+            double remaining = done > 0 ? nodes * (1 - done) / done : -1;
+
+            this->output << "Progress: " << nodes << " nodes, " << (uint64_t)rate << " nodes/s, "
+                << (done * 100) << "% done, remaining ";
+
+            if (remaining >= 0) {
+                this->output << (uint64_t)remaining << " nodes";
+            } else {
+                this->output << '?';
+            }
+
+            if (this->estimate > 0) {
+                double knuth = this->estimate > nodes ? this->estimate - nodes : 0;
+                this->output << " (probing: " << (uint64_t)knuth << ')';
+            }
+
+            this->output << ", elapsed ";
+            SearchProgress::PrintDuration(this->output, elapsed);
+            this->output << ", ETA ";
+            SearchProgress::PrintDuration(this->output, done > 0 ? elapsed * (1 - done) / done : -1);
+
+            if (this->estimate > 0 && nodes > 0) {
+                double knuth = this->estimate > nodes ? this->estimate - nodes : 0;
+                this->output << " (probing: ";
+                SearchProgress::PrintDuration(this->output, knuth * elapsed / nodes);
+                this->output << ')';
+            }
+
+            this->output << std::endl;
+
+            this->last = now;
+            this->lastNodes = nodes;
+        }
+};
@@ -0,0 +1,251 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "SearchArena.hpp"
+
+/**
+ * @brief Search state of the backtracking engines: a stack of
+ * assignments (one frame per visited cell) and an undo log of
+ * the bitmaps changed since the start of each frame.
+ *
+ * The cells can be visited in any order and any number of bitmaps
+ * can be changed by an assignment (for example by propagation).
+ * Going back to any earlier frame costs O(number of changes).
+ *
+ * Only the frames on the current path are touched, instead of
+ * a bitmap for every cell of the table.
+ */
+class SearchTrail {
+    public:
+        struct Frame {
+            uint32_t tried;     // Values already tried in the cell of this frame.
+            uint32_t mark;      // Size of the undo log when the frame was entered.
+            uint16_t pos;       // Position of the cell in the Cayley table.
+            uint8_t x;
+            uint8_t y;
+        };
+
+    private:
+        struct Change {
+            uint32_t index;
+            uint32_t old;
+        };
+
+        uint32_t *masks;
+        int maskCount;
+        Frame *frames;
+        int frameCount;
+        Change *log;
+        uint32_t logSize;
+        uint32_t logCapacity;
+        bool ownsArrays;        // False if the masks and frames are in an arena.
+        bool ownsLog;           // False until a log in an arena is outgrown.
+        std::vector<Change> savedLog;   // See SaveLog().
+
+        void Grow() {
+            Change *bigger = new Change[this->logCapacity * 2];
+            memcpy(bigger, this->log, this->logSize * sizeof(Change));
+
+            if (this->ownsLog) {
+                delete[] this->log;
+            }
+
+            this->ownsLog = true;
+            this->log = bigger;
+            this->logCapacity *= 2;
+        }
+
+        inline void Push(uint32_t index, uint32_t old) {
+            if (this->logSize >= this->logCapacity) {
+                this->Grow();
+            }
+
+            this->log[this->logSize].index = index;
+            this->log[this->logSize].old = old;
+            this->logSize++;
+        }
+
+    public:
+        /**
+         * @param maskCount Number of bitmaps which can be changed through the trail.
+         * @param frameCount Maximal depth of the search.
+         */
+        SearchTrail(int maskCount, int frameCount) : maskCount(maskCount), frameCount(frameCount) {
+            this->masks = new uint32_t[maskCount];
+            this->frames = new Frame[frameCount];
+            this->logSize = 0;
+            this->logCapacity = 4 * frameCount + 16;
+            this->log = new Change[this->logCapacity];
+            this->ownsArrays = true;
+            this->ownsLog = true;
+
+            memset(this->masks, 0, maskCount * sizeof(uint32_t));
+            memset(this->frames, 0, frameCount * sizeof(Frame));
+        }
+
+        /**
+         * @brief The arrays are taken from the arena: first the undo log,
+         * then the masks and the frames, so the engine can put them into
+         * its snapshot together with its own arrays. (See ArenaBytes.)
+         */
+        SearchTrail(int maskCount, int frameCount, SearchArena &arena)
+            : maskCount(maskCount), frameCount(frameCount) {
+
+            this->logSize = 0;
+            this->logCapacity = 4 * frameCount + 16;
+            this->log = arena.Take<Change>(this->logCapacity);
+            this->masks = arena.Take<uint32_t>(maskCount);
+            this->frames = arena.Take<Frame>(frameCount);
+            this->ownsArrays = false;
+            this->ownsLog = false;
+        }
+
+        ~SearchTrail() {
+            if (this->ownsArrays) {
+                delete[] this->masks;
+                delete[] this->frames;
+            }
+
+            if (this->ownsLog) {
+                delete[] this->log;
+            }
+        }
+
+        SearchTrail(const SearchTrail &) = delete;
+        SearchTrail& operator=(const SearchTrail &) = delete;
+
+        /**
+         * @brief Arena space used by the arena constructor.
+         */
+        static size_t ArenaBytes(int maskCount, int frameCount) {
+            return SearchArena::Bytes<Change>(4 * frameCount + 16) + SearchTrail::StateBytes(maskCount, frameCount);
+        }
+
+        /**
+         * @brief Arena space of the masks and the frames. (Part of the snapshot.)
+         */
+        static size_t StateBytes(int maskCount, int frameCount) {
+            return SearchArena::Bytes<uint32_t>(maskCount) + SearchArena::Bytes<Frame>(frameCount);
+        }
+
+        inline uint32_t* GetMasks() {
+            return this->masks;
+        }
+
+        inline Frame* GetFrames() {
+            return this->frames;
+        }
+
+        inline int GetFrameCount() const {
+            return this->frameCount;
+        }
+
+        /**
+         * @brief Assigns the cell of a frame. (Defines the visit order.)
+         */
+        void SetFrameCell(int depth, int pos, int x, int y) {
+            this->frames[depth].pos = pos;
+            this->frames[depth].x = x;
+            this->frames[depth].y = y;
+        }
+
+        /**
+         * @brief Starts a frame with an empty set of tried values.
+         */
+        inline void Enter(int depth) {
+            this->frames[depth].tried = 0;
+            this->frames[depth].mark = this->logSize;
+        }
+
+        inline void Or(int index, uint32_t bits) {
+            uint32_t old = this->masks[index];
+
+            if ((old | bits) != old) {
+                this->Push(index, old);
+                this->masks[index] = old | bits;
+            }
+        }
+
+        inline void AndNot(int index, uint32_t bits) {
+            uint32_t old = this->masks[index];
+
+            if (old & bits) {
+                this->Push(index, old);
+                this->masks[index] = old & ~bits;
+            }
+        }
+
+        inline uint32_t Mark() const {
+            return this->logSize;
+        }
+
+        /**
+         * @brief Restores all bitmaps changed after the mark.
+         */
+        inline void Undo(uint32_t mark) {
+            while(this->logSize > mark) {
+                this->logSize--;
+                this->masks[this->log[this->logSize].index] = this->log[this->logSize].old;
+            }
+        }
+
+        /**
+         * @brief Clears the bitmaps, the frames and the undo log.
+         * The cells of the frames are kept.
+         */
+        void Reset() {
+            this->logSize = 0;
+            memset(this->masks, 0, this->maskCount * sizeof(uint32_t));
+
+            for(int i = 0; i < this->frameCount; i++) {
+                this->frames[i].tried = 0;
+                this->frames[i].mark = 0;
+            }
+        }
+
+        /**
+         * @brief Empties the undo log. For engines which restore the
+         * bitmaps and the frames themselves. (For example from a snapshot.)
+         */
+        inline void ClearLog() {
+            this->logSize = 0;
+        }
+
+        /**
+         * @brief Keeps a copy of the undo log. RestoreLog() puts it back,
+         * after the engine restored the bitmaps and the frames, so the
+         * search can continue from the saved state.
+         */
+        void SaveLog() {
+            this->savedLog.assign(this->log, this->log + this->logSize);
+        }
+
+        void RestoreLog() {
+            while(this->logCapacity < this->savedLog.size()) {
+                this->Grow();
+            }
+
+            if (!this->savedLog.empty()) {
+                memcpy(this->log, &this->savedLog[0], this->savedLog.size() * sizeof(Change));
+            }
+
+            this->logSize = this->savedLog.size();
+        }
+};
@@ -0,0 +1,565 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "AssocHeuristics.hpp"
+#include "EnginePool.hpp"
+
+/**
+ * @brief A self-contained piece of work: a partial Cayley table
+ * whose first "depth" free cells (in raster order) are fixed.
+ * The subtree below it can be searched by any process.
+ *
+ * File format (text):
+ *      order <n>
+ *      depth <d>
+ *      unit <id>
+ *      <n rows of the table in the GetAsText() format>
+ *
+ * The track bitmaps of the prefix cells are not stored, since
+ * backtracking never enters the prefix. The remaining cells
+ * start with an empty track.
+ */
+class WorkUnit {
+    public:
+        int order;
+        int depth;
+        int id;
+        std::vector<uint8_t> cayley;
+
+        WorkUnit() : order(0), depth(0), id(0) { }
+
+        WorkUnit(int order, int depth, int id, const uint8_t *cayley)
+            : order(order), depth(depth), id(id), cayley(cayley, cayley + order * order) { }
+
+        /**
+         * @brief Writes the unit into a temporary file, then renames it,
+         * so the workers never see a partial unit.
+         */
+        void Save(const std::string &path) const {
+            std::string temporary = path + ".tmp";
+            std::ofstream file(temporary.c_str());
+
+            if (!file) {
+                throw std::runtime_error("Unable to write work unit: " + path);
+            }
+
+            file << "order " << this->order << '\n';
+            file << "depth " << this->depth << '\n';
+            file << "unit " << this->id << '\n';
+            WorkUnit::WriteTable(file, this->order, &this->cayley[0]);
+            file.close();
+
+            if (!file || rename(temporary.c_str(), path.c_str()) != 0) {
+                unlink(temporary.c_str());
+                throw std::runtime_error("Unable to write work unit: " + path);
+            }
+        }
+
+        void Load(const std::string &path) {
+            std::ifstream file(path.c_str());
+            std::string key;
+
+            if (!file) {
+                throw std::runtime_error("Unable to read work unit: " + path);
+            }
+
+            file >> key >> this->order;
+            if (key != "order" || this->order < 2 || this->order > 31) {
+                throw std::runtime_error("Invalid work unit (order): " + path);
+            }
+
+            file >> key >> this->depth;
+            if (key != "depth" || this->depth < 0 || this->depth >= this->order * this->order) {
+                throw std::runtime_error("Invalid work unit (depth): " + path);
+            }
+
+            file >> key >> this->id;
+            if (key != "unit") {
+                throw std::runtime_error("Invalid work unit (id): " + path);
+            }
+
+            this->cayley.assign(this->order * this->order, 0);
+
+            if (!WorkUnit::ReadTable(file, this->order, &this->cayley[0])) {
+                throw std::runtime_error("Invalid work unit (table): " + path);
+            }
+        }
+
+        /**
+         * @brief Writes a table in the same format as GetAsText().
+         */
+        static void WriteTable(std::ostream &output, int order, const uint8_t *cayley) {
+            char cell[4];
+
+            for(int i = 0; i < order; i++) {
+                for(int j = 0; j < order; j++) {
+                    int value = cayley[i * order + j];
+
+                    if (value >= 100) {
+                        output << value << ';';
+                        continue;
+                    }
+
+                    cell[0] = '0' + value / 10;
+                    cell[1] = '0' + value % 10;
+                    cell[2] = ';';
+                    output.write(cell, 3);
+                }
+
+                output << '\n';
+            }
+        }
+
+        /**
+         * @brief Reads the next table written by WriteTable() or GetAsText().
+         * Skips blank lines and lines starting with '#'.
+         * @param comment If given, receives the last '#' line skipped.
+         * @return False if the end of the input was reached first.
+         */
+        static bool ReadTable(std::istream &input, int order, uint8_t *cayley, std::string *comment = nullptr) {
+            std::string line;
+            int row = 0;
+
+            while(row < order && std::getline(input, line)) {
+                if (comment != nullptr && !line.empty() && line[0] == '#') {
+                    *comment = line;
+                }
+
+                if (line.empty() || line[0] == '#' || line.find(';') == std::string::npos) {
+                    continue;
+                }
+
+                int column = 0;
+                int value = 0;
+
+                for(char c : line) {
+                    if (c >= '0' && c <= '9') {
+                        value = value * 10 + (c - '0');
+                    }
+                    else if (c == ';') {
+                        if (column >= order || value > order) {
+                            return false;
+                        }
+
+                        cayley[row * order + column++] = value;
+                        value = 0;
+                    }
+                }
+
+                if (column != order) {
+                    return false;
+                }
+
+                row++;
+            }
+
+            return row == order;
+        }
+};
+
+/**
+ * @brief Splits an AssocHeuristics search into work unit files,
+ * lets independent worker processes consume them, then merges
+ * the results. The processes only communicate through files in
+ * a shared directory, so no network service is needed.
+ *
+ * Directory layout:
+ *      shards.txt                          Order, depth and the number of units.
+ *      unit-000017.unit                    Waiting to be processed.
+ *      unit-000017.claimed.<host>.<pid>    Being processed by a worker.
+ *      unit-000017.result                  Finished. Contains the tables found.
+ *      unit-000017.invalid                 Unreadable unit, moved aside by a worker.
+ *
+ * A worker claims a unit by renaming it, which is atomic on a
+ * local file system. Results are written into a temporary file
+ * first, then renamed, so a partial result file is never visible.
+ * If the processing fails, the claim is renamed back. The claims of
+ * workers which died can be put back with Requeue(). A unit which
+ * can't be loaded is renamed to ".invalid", so the others go on.
+ */
+class Sharding {
+    private:
+        std::string directory;
+        std::string claimSuffix;        // .<host>.<pid> of this process
+
+        static std::string HostName() {
+            char name[256];
+
+            if (gethostname(name, sizeof(name)) != 0) {
+                return "unknown";
+            }
+
+            name[sizeof(name) - 1] = '\0';
+
+            return name;
+        }
+
+        /**
+         * @brief The claims in the directory: unit ID and file name.
+         */
+        std::vector<std::pair<int, std::string>> ListClaims() const {
+            std::vector<std::pair<int, std::string>> claims;
+            DIR *dir = opendir(this->directory.c_str());
+
+            if (dir == nullptr) {
+                throw std::runtime_error("Unable to open directory: " + this->directory);
+            }
+
+            struct dirent *entry;
+
+            while((entry = readdir(dir)) != nullptr) {
+                std::string name(entry->d_name);
+
+                if (name.compare(0, 5, "unit-") == 0 && name.find(".claimed.") != std::string::npos) {
+                    claims.push_back(std::make_pair(atoi(name.c_str() + 5), name));
+                }
+            }
+
+            closedir(dir);
+            std::sort(claims.begin(), claims.end());
+
+            return claims;
+        }
+
+        /**
+         * @brief Whether the owner of a claim is known to be dead: it
+         * ran on this host, and no process has its ID.
+         */
+        bool IsStale(const std::string &name) const {
+            size_t start = name.find(".claimed.") + 9;
+            size_t dot = name.rfind('.');
+
+            if (dot < start) {
+                return false;
+            }
+
+            std::string host = name.substr(start, dot - start);
+            int pid = atoi(name.c_str() + dot + 1);
+
+            return host == Sharding::HostName() && pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+        }
+
+        std::string UnitPath(int id, const char *extension) const {
+            char name[32];
+            snprintf(name, sizeof(name), "unit-%06d.%s", id, extension);
+            return this->directory + "/" + name;
+        }
+
+        /**
+         * @brief Returns the IDs of the files with the given extension.
+         */
+        std::vector<int> ListUnits(const char *extension) const {
+            std::vector<int> ids;
+            DIR *dir = opendir(this->directory.c_str());
+
+            if (dir == nullptr) {
+                throw std::runtime_error("Unable to open directory: " + this->directory);
+            }
+
+            std::string suffix = std::string(".") + extension;
+            struct dirent *entry;
+
+            while((entry = readdir(dir)) != nullptr) {
+                std::string name(entry->d_name);
+
+                if (name.size() <= 5 + suffix.size() || name.compare(0, 5, "unit-") != 0
+                    || name.compare(name.size() - suffix.size(), std::string::npos, suffix) != 0) {
+                    continue;
+                }
+
+                ids.push_back(atoi(name.c_str() + 5));
+            }
+
+            closedir(dir);
+            std::sort(ids.begin(), ids.end());
+
+            return ids;
+        }
+
+        void ReadManifest(int &order, int &depth, int &units) const {
+            std::ifstream file((this->directory + "/shards.txt").c_str());
+            std::string key1, key2, key3;
+
+            file >> key1 >> order >> key2 >> depth >> key3 >> units;
+
+            if (!file || key1 != "order" || key2 != "depth" || key3 != "units") {
+                throw std::runtime_error("Missing or invalid shards.txt in " + this->directory);
+            }
+        }
+
+    public:
+        Sharding(const std::string &directory) : directory(directory) {
+            this->claimSuffix = "." + Sharding::HostName() + "." + std::to_string(getpid());
+        }
+
+        /**
+         * @brief Enumerates all consistent prefixes of the given depth
+         * and writes each one into a separate work unit file.
+         *
+         * @return The number of units written.
+         */
+        int CreateUnits(int order, int depth) {
+            AssocHeuristics heuristics(order);
+            int count = 0;
+
+            heuristics.SetDepthLimit(depth);
+
+            if (mkdir(this->directory.c_str(), 0755) != 0 && errno != EEXIST) {
+                throw std::runtime_error("Unable to create directory: " + this->directory + " ("
+                    + strerror(errno) + ")");
+            }
+
+            while(true) {
+                heuristics.Next();
+
+                if (!heuristics.Found()) {
+                    break;
+                }
+
+                WorkUnit unit(order, depth, count, heuristics.GetCayley());
+                unit.Save(this->UnitPath(count, "unit"));
+                count++;
+            }
+
+            std::ofstream manifest((this->directory + "/shards.txt").c_str());
+            manifest << "order " << order << "\ndepth " << depth << "\nunits " << count << '\n';
+
+            if (!manifest) {
+                throw std::runtime_error("Unable to write shards.txt in " + this->directory);
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief Puts claimed units back into the queue: the claims of
+         * dead workers on this host, or all claims with "force" (for
+         * workers on other hosts, which can't be checked).
+         *
+         * @return The number of units requeued.
+         */
+        int Requeue(bool force) {
+            int requeued = 0;
+
+            for(const std::pair<int, std::string> &claim : this->ListClaims()) {
+                if (!force && !this->IsStale(claim.second)) {
+                    continue;
+                }
+
+                std::string path = this->directory + "/" + claim.second;
+
+                /*
+                    Fails if the worker finished it in the meantime.
+                */
+                if (rename(path.c_str(), this->UnitPath(claim.first, "unit").c_str()) == 0) {
+                    requeued++;
+                }
+            }
+
+            return requeued;
+        }
+
+        /**
+         * @brief Claims and processes units until none is left.
+         * Any number of workers can run this on the same directory.
+         * The stale claims of this host are requeued first.
+         *
+         * @return The number of units processed by this worker.
+         */
+        int Work() {
+            EnginePool<AssocHeuristics> pool;
+            int processed = 0;
+            std::string claimed;
+
+            this->Requeue(false);
+
+            while(true) {
+                std::vector<int> ids = this->ListUnits("unit");
+                bool claimedAny = false;
+
+                for(int id : ids) {
+                    std::string waiting = this->UnitPath(id, "unit");
+                    WorkUnit unit;
+
+                    /*
+                        Validate before claiming, so an invalid unit is
+                        never left claimed. It is moved aside instead,
+                        and the other units are processed.
+                    */
+                    try {
+                        unit.Load(waiting);
+                    }
+                    catch (const std::exception &e) {
+                        // Fails if another worker was faster.
+                        if (rename(waiting.c_str(), this->UnitPath(id, "invalid").c_str()) == 0) {
+                            std::cerr << e.what() << " (moved to .invalid)\n";
+                        }
+
+                        continue;
+                    }
+
+                    claimed = this->UnitPath(id, "claimed") + this->claimSuffix;
+
+                    if (rename(waiting.c_str(), claimed.c_str()) != 0) {
+                        // Another worker was faster.
+                        continue;
+                    }
+
+                    claimedAny = true;
+
+                    try {
+                        this->Process(id, unit, pool);
+                    }
+                    catch (...) {
+                        rename(claimed.c_str(), waiting.c_str());
+                        throw;
+                    }
+
+                    unlink(claimed.c_str());
+                    processed++;
+                }
+
+                if (!claimedAny) {
+                    break;
+                }
+            }
+
+            return processed;
+        }
+
+        /**
+         * @brief Searches the subtree of a single claimed unit.
+         * The engine is taken from the pool of the worker.
+         */
+        void Process(int id, const WorkUnit &unit, EnginePool<AssocHeuristics> &pool) {
+            EnginePool<AssocHeuristics>::Lease heuristics(pool, unit.order);
+            heuristics->LoadPrefix(&unit.cayley[0], unit.depth);
+
+            std::string temporary = this->UnitPath(id, "tmp") + "." + std::to_string(getpid());
+            std::ofstream file(temporary.c_str());
+            long count = 0;
+
+            while(true) {
+                heuristics->Next();
+
+                if (!heuristics->Found()) {
+                    break;
+                }
+
+                file << '\n';
+                WorkUnit::WriteTable(file, unit.order, heuristics->GetCayley());
+                count++;
+            }
+
+            file << "\n# count " << count << '\n';
+            file.close();
+
+            if (!file || rename(temporary.c_str(), this->UnitPath(id, "result").c_str()) != 0) {
+                unlink(temporary.c_str());
+                throw std::runtime_error("Unable to write the result of unit " + std::to_string(id));
+            }
+        }
+
+        /**
+         * @brief Concatenates the tables of all result files into
+         * the output, in unit order. Prints a summary to "log".
+         * A result file is only merged if its "# count" trailer
+         * matches the number of tables read, else the unit is
+         * reported as unfinished.
+         *
+         * @return The total number of tables.
+         */
+        long Merge(std::ostream &output, std::ostream &log) {
+            int order, depth, units;
+            this->ReadManifest(order, depth, units);
+
+            std::vector<int> ids = this->ListUnits("result");
+            std::vector<uint8_t> cayley(order * order);
+            std::vector<uint8_t> tables;
+            std::vector<std::string> broken;
+            int finished = 0;
+            long total = 0;
+
+            for(int id : ids) {
+                std::ifstream file(this->UnitPath(id, "result").c_str());
+                std::string trailer;
+                long count = 0;
+                long expected = -1;
+
+                tables.clear();
+
+                while(WorkUnit::ReadTable(file, order, &cayley[0], &trailer)) {
+                    tables.insert(tables.end(), cayley.begin(), cayley.end());
+                    count++;
+                }
+
+                if (sscanf(trailer.c_str(), "# count %ld", &expected) != 1 || expected != count) {
+                    broken.push_back("Unit " + std::to_string(id) + ": the result file is incomplete ("
+                        + std::to_string(count) + " tables read, "
+                        + (expected < 0 ? std::string("no count trailer") : "count trailer: " + std::to_string(expected))
+                        + "): " + this->UnitPath(id, "result"));
+                    continue;
+                }
+
+                for(long i = 0; i < count; i++) {
+                    WorkUnit::WriteTable(output, order, &tables[i * order * order]);
+                    output << '\n';
+                }
+
+                log << "Unit " << id << ": " << count << '\n';
+                total += count;
+                finished++;
+            }
+
+            log << "Order: " << order << ", depth: " << depth << ", units finished: "
+                << finished << " / " << units << ", tables: " << total << '\n';
+
+            if (finished != units) {
+                log << "Warning: " << (units - finished) << " unit(s) are not finished yet.\n";
+
+                for(const std::string &message : broken) {
+                    log << message << '\n';
+                }
+
+                for(int id : this->ListUnits("invalid")) {
+                    log << "Unit " << id << " is invalid: " << this->UnitPath(id, "invalid") << '\n';
+                }
+
+                for(const std::pair<int, std::string> &claim : this->ListClaims()) {
+                    log << "Unit " << claim.first << " is claimed: " << claim.second
+                        << (this->IsStale(claim.second) ? " (the worker is dead, run requeue)" : "") << '\n';
+                }
+            }
+
+            return total;
+        }
+};
@@ -0,0 +1,522 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+#include "AssocHeuristics.hpp"
+#include "Classifier.hpp"
+#include "CycleGraph.hpp"
+#include "TableWriter.hpp"
+
+/**
+ * @brief Bounded lock-free queue of Cayley tables, for passing the
+ * results of search threads to analysis threads.
+ *
+ * All table slots are allocated once in the constructor. Push() and
+ * Pop() copy a table into or out of a slot, so no memory is allocated
+ * per table. (Multi-producer multi-consumer ring with a sequence
+ * number in each slot, by Dmitry Vyukov.)
+ *
+ * When the ring is full, the producers wait (backpressure), when
+ * it is empty the consumers wait. The waiting times are measured.
+ * A waiting thread spins for a short while, then blocks on a
+ * condition variable, so idle threads don't take the CPU from the
+ * others. Only the waits take a lock: the other side checks the
+ * number of blocked threads after each push or pop, and signals
+ * them if there are any. Shutdown() releases both sides, for
+ * stopping on an error.
+ */
+class TableRing {
+    private:
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+        };
+
+        int tableSize;
+        uint64_t mask;
+        Slot *slots;
+        uint8_t *tables;
+
+        // Separate cache lines for the two ends of the queue.
+        alignas(64) std::atomic<uint64_t> enqueuePos;
+        alignas(64) std::atomic<uint64_t> dequeuePos;
+        alignas(64) std::atomic<int> producers;
+        std::atomic<bool> closed;
+
+        // Blocked threads: producers on a full ring, consumers on an empty one.
+        alignas(64) std::atomic<int> blockedProducers;
+        std::atomic<int> blockedConsumers;
+        std::mutex fullMutex;
+        std::mutex emptyMutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+
+        std::atomic<uint64_t> pushed;
+        std::atomic<uint64_t> depthSum;
+        std::atomic<uint64_t> maxDepth;
+        std::atomic<uint64_t> producerStalls;
+        std::atomic<uint64_t> producerStallNs;
+        std::atomic<uint64_t> consumerStalls;
+        std::atomic<uint64_t> consumerStallNs;
+
+        static const int SpinCount = 16;     // Yields before blocking.
+
+        static uint64_t Elapsed(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+        bool IsFull() const {
+            uint64_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+            return (int64_t)this->slots[pos & this->mask].sequence.load(std::memory_order_acquire) - (int64_t)pos < 0;
+        }
+
+        bool IsEmpty() const {
+            uint64_t pos = this->dequeuePos.load(std::memory_order_relaxed);
+            return (int64_t)this->slots[pos & this->mask].sequence.load(std::memory_order_acquire) - (int64_t)(pos + 1) < 0;
+        }
+
+        /**
+         * @brief Wakes the threads blocked on the condition, if any.
+         * The fence orders the push or pop before the check of the
+         * counter, and the blocked threads increment it before their
+         * last check, so no signal is lost.
+         */
+        static void Signal(std::atomic<int> &blocked, std::mutex &mutex, std::condition_variable &condition, bool all) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (blocked.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (all) {
+                    condition.notify_all();
+                } else {
+                    condition.notify_one();
+                }
+            }
+        }
+
+    public:
+        /**
+         * @param order Order of the groups.
+         * @param capacity Number of table slots. Rounded up to a power of 2.
+         * @param producers The number of producer threads. Pop() returns
+         * false after all of them called ProducerDone() and the queue is empty.
+         */
+        TableRing(int order, int capacity, int producers)
+            : tableSize(order * order), enqueuePos(0), dequeuePos(0), producers(producers),
+              closed(false), blockedProducers(0), blockedConsumers(0), pushed(0), depthSum(0), maxDepth(0), producerStalls(0), producerStallNs(0),
+              consumerStalls(0), consumerStallNs(0) {
+
+            if (capacity < 2) {
+                throw std::runtime_error("TableRing: the capacity must be at least 2.");
+            }
+
+            uint64_t size = 2;
+            while(size < (uint64_t)capacity) {
+                size <<= 1;
+            }
+
+            this->mask = size - 1;
+            this->slots = new Slot[size];
+            this->tables = new uint8_t[size * this->tableSize];
+
+            for(uint64_t i = 0; i < size; i++) {
+                this->slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        ~TableRing() {
+            delete[] this->slots;
+            delete[] this->tables;
+        }
+
+        bool TryPush(const uint8_t *cayley) {
+            uint64_t pos = this->enqueuePos.load(std::memory_order_relaxed);
+            Slot *slot;
+
+            while(true) {
+                slot = &this->slots[pos & this->mask];
+                uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+                int64_t diff = (int64_t)sequence - (int64_t)pos;
+
+                if (diff == 0) {
+                    if (this->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (diff < 0) {
+                    // Full
+                    return false;
+                }
+                else {
+                    pos = this->enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            memcpy(this->tables + (pos & this->mask) * this->tableSize, cayley, this->tableSize);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+
+            /*
+                Statistics: queue depth at the time of the push.
+            */
+            int64_t signedDepth = (int64_t)(pos + 1 - this->dequeuePos.load(std::memory_order_relaxed));
+            uint64_t depth = signedDepth > 0 ? signedDepth : 0;
+            uint64_t max = this->maxDepth.load(std::memory_order_relaxed);
+
+            while(depth > max && !this->maxDepth.compare_exchange_weak(max, depth, std::memory_order_relaxed)) { }
+
+            this->depthSum.fetch_add(depth, std::memory_order_relaxed);
+            this->pushed.fetch_add(1, std::memory_order_relaxed);
+
+            TableRing::Signal(this->blockedConsumers, this->emptyMutex, this->notEmpty, false);
+
+            return true;
+        }
+
+        bool TryPop(uint8_t *cayley) {
+            uint64_t pos = this->dequeuePos.load(std::memory_order_relaxed);
+            Slot *slot;
+
+            while(true) {
+                slot = &this->slots[pos & this->mask];
+                uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+                int64_t diff = (int64_t)sequence - (int64_t)(pos + 1);
+
+                if (diff == 0) {
+                    if (this->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (diff < 0) {
+                    // Empty
+                    return false;
+                }
+                else {
+                    pos = this->dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            memcpy(cayley, this->tables + (pos & this->mask) * this->tableSize, this->tableSize);
+            slot->sequence.store(pos + this->mask + 1, std::memory_order_release);
+
+            TableRing::Signal(this->blockedProducers, this->fullMutex, this->notFull, false);
+
+            return true;
+        }
+
+        /**
+         * @brief Waits while the queue is full. After Shutdown() the
+         * table is dropped.
+         */
+        void Push(const uint8_t *cayley) {
+            if (this->TryPush(cayley)) {
+                return;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            for(int spin = 0; !this->closed.load(std::memory_order_acquire); spin++) {
+                if (spin < TableRing::SpinCount) {
+                    std::this_thread::yield();
+                } else {
+                    std::unique_lock<std::mutex> lock(this->fullMutex);
+                    this->blockedProducers.fetch_add(1);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                    if (this->IsFull() && !this->closed.load()) {
+                        this->notFull.wait(lock);
+                    }
+
+                    this->blockedProducers.fetch_sub(1);
+                }
+
+                if (this->TryPush(cayley)) {
+                    break;
+                }
+            }
+
+            this->producerStalls.fetch_add(1, std::memory_order_relaxed);
+            this->producerStallNs.fetch_add(TableRing::Elapsed(start), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Waits while the queue is empty.
+         * @return False if all producers are done and the queue is
+         * empty, or after Shutdown().
+         */
+        bool Pop(uint8_t *cayley) {
+            if (this->TryPop(cayley)) {
+                return true;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bool result;
+
+            for(int spin = 0; ; spin++) {
+                if (this->closed.load(std::memory_order_acquire)) {
+                    result = false;
+                    break;
+                }
+
+                if (this->TryPop(cayley)) {
+                    result = true;
+                    break;
+                }
+
+                if (this->producers.load(std::memory_order_acquire) == 0) {
+                    /*
+                        A push might have happened between the two checks.
+                    */
+                    result = this->TryPop(cayley);
+                    break;
+                }
+
+                if (spin < TableRing::SpinCount) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(this->emptyMutex);
+                this->blockedConsumers.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (this->IsEmpty() && !this->closed.load() && this->producers.load() > 0) {
+                    this->notEmpty.wait(lock);
+                }
+
+                this->blockedConsumers.fetch_sub(1);
+            }
+
+            this->consumerStalls.fetch_add(1, std::memory_order_relaxed);
+            this->consumerStallNs.fetch_add(TableRing::Elapsed(start), std::memory_order_relaxed);
+
+            return result;
+        }
+
+        void ProducerDone() {
+            this->producers.fetch_sub(1);
+            TableRing::Signal(this->blockedConsumers, this->emptyMutex, this->notEmpty, true);
+        }
+
+        /**
+         * @brief Stops the waiting of both sides: Push() drops the
+         * tables and Pop() returns false.
+         */
+        void Shutdown() {
+            this->closed.store(true);
+            TableRing::Signal(this->blockedProducers, this->fullMutex, this->notFull, true);
+            TableRing::Signal(this->blockedConsumers, this->emptyMutex, this->notEmpty, true);
+        }
+
+        uint64_t GetCapacity() const {
+            return this->mask + 1;
+        }
+
+        void PrintStats(std::ostream &output) const {
+            uint64_t pushed = this->pushed.load();
+
+            output << "Tables: " << pushed
+                << ", capacity: " << this->GetCapacity()
+                << ", max depth: " << this->maxDepth.load()
+                << ", avg depth: " << (pushed ? (double)this->depthSum.load() / pushed : 0.0) << '\n'
+                << "Producer stalls (queue full): " << this->producerStalls.load()
+                << ", " << (this->producerStallNs.load() / 1e6) << " ms\n"
+                << "Consumer stalls (queue empty): " << this->consumerStalls.load()
+                << ", " << (this->consumerStallNs.load() / 1e6) << " ms\n";
+        }
+};
+
+/**
+ * @brief Runs the search and the analysis of the results in parallel.
+ *
+ * The search is split into prefixes of the given depth (see
+ * AssocHeuristics::SetDepthLimit), which are taken by the search
+ * threads one by one. The tables found are passed through a
+ * TableRing to the analysis threads, which run the Classifier
+ * and the CycleGraph on them.
+ */
+class TablePipeline {
+    private:
+        int order;
+        int searchThreads;
+        int analysisThreads;
+        int depth;
+        std::vector<uint8_t> prefixes;
+        int prefixCount;
+        std::atomic<int> nextPrefix;
+        TableRing ring;
+        std::mutex outputMutex;
+        std::ostream &output;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        /**
+         * @brief Keeps the first error, and stops the other threads.
+         */
+        void Fail() {
+            std::lock_guard<std::mutex> lock(this->errorMutex);
+
+            if (!this->error) {
+                this->error = std::current_exception();
+            }
+
+            this->nextPrefix = this->prefixCount;
+            this->ring.Shutdown();
+        }
+
+        void SearchWorker() {
+            try {
+                this->Search();
+            }
+            catch (...) {
+                this->Fail();
+            }
+
+            this->ring.ProducerDone();
+        }
+
+        void AnalysisWorker() {
+            try {
+                this->Analyze();
+            }
+            catch (...) {
+                this->Fail();
+            }
+        }
+
+        void Search() {
+            AssocHeuristics heuristics(this->order);
+            int index;
+
+            while((index = this->nextPrefix.fetch_add(1)) < this->prefixCount) {
+                heuristics.LoadPrefix(&this->prefixes[index * this->order * this->order], this->depth);
+
+                while(true) {
+                    heuristics.Next();
+
+                    if (!heuristics.Found()) {
+                        break;
+                    }
+
+                    this->ring.Push(heuristics.GetCayley());
+                }
+            }
+        }
+
+        void Analyze() {
+            std::vector<uint8_t> cayley(this->order * this->order);
+            CycleGraph graph;
+            TableWriter writer;
+
+            while(this->ring.Pop(&cayley[0])) {
+                Classifier classifier(this->order, &cayley[0]);
+                classifier.WriteGroup(writer);
+                writer.Append("\n\n", 2);
+
+                graph.Build(this->order, &cayley[0]);
+                graph.WriteCyclicSubgroups(writer);
+                writer.Append('\n');
+
+                writer.Append("Properties: ");
+                classifier.WriteAllProperties(writer);
+                writer.Append("\n\n", 2);
+
+                std::lock_guard<std::mutex> lock(this->outputMutex);
+                writer.Flush(this->output);
+            }
+        }
+
+    public:
+        /**
+         * @param depth The depth of the prefixes, which are the units of
+         * work for the search threads. (At least 1.)
+         * @param capacity The number of table slots in the queue.
+         */
+        TablePipeline(int order, int searchThreads, int analysisThreads, int depth, int capacity,
+            std::ostream &output)
+            : order(order), searchThreads(searchThreads), analysisThreads(analysisThreads),
+              depth(depth), prefixCount(0), nextPrefix(0), ring(order, capacity, searchThreads),
+              output(output) {
+
+            if (searchThreads < 1 || analysisThreads < 1) {
+                throw std::runtime_error("TablePipeline: at least 1 search and 1 analysis thread is needed.");
+            }
+
+            AssocHeuristics heuristics(order);
+
+            /*
+                The prefixes must leave free cells for LoadPrefix().
+            */
+            if (depth < 1 || depth >= heuristics.GetFreeCellCount()) {
+                throw std::runtime_error("TablePipeline: invalid prefix depth. Allowed: 1 -> "
+                    + std::to_string(heuristics.GetFreeCellCount() - 1));
+            }
+
+            heuristics.SetDepthLimit(depth);
+
+            while(true) {
+                heuristics.Next();
+
+                if (!heuristics.Found()) {
+                    break;
+                }
+
+                this->prefixes.insert(this->prefixes.end(), heuristics.GetCayley(),
+                    heuristics.GetCayley() + order * order);
+                this->prefixCount++;
+            }
+        }
+
+        /**
+         * @brief Runs the threads. The first error of a thread stops
+         * the others, and is rethrown after they finished.
+         */
+        void Run() {
+            std::vector<std::thread> threads;
+
+            for(int i = 0; i < this->analysisThreads; i++) {
+                threads.push_back(std::thread(&TablePipeline::AnalysisWorker, this));
+            }
+
+            for(int i = 0; i < this->searchThreads; i++) {
+                threads.push_back(std::thread(&TablePipeline::SearchWorker, this));
+            }
+
+            for(auto &thread : threads) {
+                thread.join();
+            }
+
+            if (this->error) {
+                std::rethrow_exception(this->error);
+            }
+        }
+
+        void PrintStats(std::ostream &output) const {
+            output << "Prefixes: " << this->prefixCount << " (depth " << this->depth << ")\n";
+            this->ring.PrintStats(output);
+        }
+};
@@ -0,0 +1,209 @@
+/*
+    Copyright 2020 Tamas Bolner
+    
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+    
+      http://www.apache.org/licenses/LICENSE-2.0
+    
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdexcept>
+
+/**
+ * @brief Output buffer for the text formats of the tables, subgroups
+ * and cycle graphs. (See Classifier::WriteGroup, CycleGraph::WriteGraphVizCode.)
+ *
+ * The buffer is kept between uses: Clear() only resets the length, so
+ * a writer owned by a thread stops allocating after the first few
+ * outputs. The numbers 0 -> 255 are copied from a precomputed table,
+ * instead of going through the formatting of the streams.
+ */
+class TableWriter {
+    private:
+        std::vector<char> buffer;
+        size_t length;
+
+        /**
+         * @brief [value * 4]: the number of digits, then the digits.
+         */
+        static const char* DigitTable() {
+            static const struct Table {
+                char digits[256 * 4];
+
+                Table() {
+                    for(int value = 0; value < 256; value++) {
+                        char *entry = digits + value * 4;
+
+                        if (value >= 100) {
+                            entry[0] = 3;
+                            entry[1] = '0' + value / 100;
+                            entry[2] = '0' + value / 10 % 10;
+                            entry[3] = '0' + value % 10;
+                        }
+                        else if (value >= 10) {
+                            entry[0] = 2;
+                            entry[1] = '0' + value / 10;
+                            entry[2] = '0' + value % 10;
+                        } else {
+                            entry[0] = 1;
+                            entry[1] = '0' + value;
+                        }
+                    }
+                }
+            } table;
+
+            return table.digits;
+        }
+
+        inline void Reserve(size_t extra) {
+            if (this->length + extra > this->buffer.size()) {
+                this->buffer.resize(std::max(this->buffer.size() * 2, this->length + extra));
+            }
+        }
+
+    public:
+        TableWriter(size_t capacity = 4096) : buffer(capacity > 0 ? capacity : 1), length(0) { }
+
+        void Clear() {
+            this->length = 0;
+        }
+
+        const char* GetData() const {
+            return &this->buffer[0];
+        }
+
+        size_t GetSize() const {
+            return this->length;
+        }
+
+        std::string ToString() const {
+            return std::string(&this->buffer[0], this->length);
+        }
+
+        inline void Append(const char *text, size_t size) {
+            this->Reserve(size);
+            memcpy(&this->buffer[this->length], text, size);
+            this->length += size;
+        }
+
+        inline void Append(const char *text) {
+            this->Append(text, strlen(text));
+        }
+
+        inline void Append(char c) {
+            this->Reserve(1);
+            this->buffer[this->length++] = c;
+        }
+
+        /**
+         * @brief Decimal number, like "<<" for an int.
+         */
+        inline void AppendNumber(int value) {
+            if (value >= 0 && value < 256) {
+                const char *entry = TableWriter::DigitTable() + value * 4;
+                this->Append(entry + 1, entry[0]);
+                return;
+            }
+
+            std::string text = std::to_string(value);
+            this->Append(text.data(), text.size());
+        }
+
+        /**
+         * @brief At least 2 digits, with a leading zero. (The cells of the table format.)
+         */
+        inline void AppendPadded(int value) {
+            if (value >= 0 && value < 10) {
+                this->Append('0');
+            }
+
+            this->AppendNumber(value);
+        }
+
+        /**
+         * @brief The lowest "bits" bits of the value, like std::bitset.
+         */
+        inline void AppendBits(uint32_t value, int bits) {
+            this->Reserve(bits);
+
+            for(int i = bits - 1; i >= 0; i--) {
+                this->buffer[this->length++] = '0' + ((value >> i) & 1);
+            }
+        }
+
+        /**
+         * @brief The Markdown separator row of a table with the given
+         * number of columns, without the first "|".
+         */
+        inline void AppendSeparator(int columns) {
+            static const char cell[] = " --- |";
+
+            this->Reserve(columns * 6);
+
+            for(int i = 0; i < columns; i++) {
+                memcpy(&this->buffer[this->length], cell, 6);
+                this->length += 6;
+            }
+        }
+
+        /**
+         * @brief A table in the format of GetAsText() and WorkUnit::WriteTable(). (1-based values)
+         */
+        void WriteTable(int order, const uint8_t *cayley) {
+            for(int i = 0; i < order; i++) {
+                for(int j = 0; j < order; j++) {
+                    this->AppendPadded(cayley[i * order + j]);
+                    this->Append(';');
+                }
+
+                this->Append('\n');
+            }
+        }
+
+        /**
+         * @brief Writes the content to the stream and clears it.
+         */
+        void Flush(std::ostream &output) {
+            output.write(&this->buffer[0], this->length);
+            this->length = 0;
+        }
+
+        /**
+         * @brief Writes the content to the file descriptor and clears it.
+         */
+        void Flush(int fd) {
+            size_t written = 0;
+
+            while(written < this->length) {
+                ssize_t result = ::write(fd, &this->buffer[written], this->length - written);
+
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    throw std::runtime_error("TableWriter: write failed: " + std::string(strerror(errno)));
+                }
+
+                written += result;
+            }
+
+            this->length = 0;
+        }
+};
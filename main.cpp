@@ -14,19 +14,34 @@
     limitations under the License.
 */
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <stdlib.h>
 #include "LatinHeuristics.hpp"
 #include "AssocHeuristics.hpp"
 #include "RandomHeuristics.hpp"
 #include "CycleGraph.hpp"
 #include "Classifier.hpp"
+#include "Sharding.hpp"
+#include "TablePipeline.hpp"
+#include "AbelianGroups.hpp"
+#include "LatinClasses.hpp"
+#include "Automorphisms.hpp"
+#include "JacobsonMatthews.hpp"
+#include "LocalSearch.hpp"
+#include "ExtensionSearch.hpp"
+#include "BatchAnalyzer.hpp"
+#include "LatinLanes.hpp"
+#include "LabelledCounter.hpp"
 
-int main() {
+int Explore() {
     int order = 8;
     AssocHeuristics heuristics(order);
 
     while(true) {
         heuristics.Next();
-        
+
         if (!heuristics.Found()) {
             std::cout << "\nNothing found.\n\n";
             return 0;
@@ -34,7 +49,7 @@ int main() {
 
         Classifier classifier(order, heuristics.GetCayley());
         std::cout << classifier.PrintGroup() << "\n\n";
-        
+
         CycleGraph graph(order, heuristics.GetCayley());
         std::cout << graph.PrintCyclicSubgroups() << "\n";
 
@@ -45,6 +60,608 @@ int main() {
 
         std::cin.get();
     }
-    
+
+    return 0;
+}
+
+/**
+ * @brief Runs a full AssocHeuristics search with the given options
+ * and prints the number of tables, nodes and the time per node.
+ */
+template<typename Configure>
+void BenchRow(const char *name, int order, Configure configure) {
+    AssocHeuristics heuristics(order);
+    configure(heuristics);
+
+    auto start = std::chrono::steady_clock::now();
+    long tables = 0;
+
+    while(true) {
+        heuristics.Next();
+
+        if (!heuristics.Found()) {
+            break;
+        }
+
+        tables++;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t nodes = heuristics.GetNodeCount();
+
+    std::cout << "| " << name << " | " << tables << " | " << nodes << " | " << seconds << " | "
+        << (nodes ? seconds * 1e9 / nodes : 0.0) << " |\n" << std::flush;
+
+    if (heuristics.GetNogoodCache() != nullptr) {
+        heuristics.GetNogoodCache()->PrintStats(std::cerr);
+    }
+
+    if (heuristics.GetAllDifferent() != nullptr) {
+        heuristics.GetAllDifferent()->PrintStats(std::cerr);
+    }
+}
+
+int Bench(int order) {
+    std::cout << "| Order " << order << " | Tables | Nodes | Seconds | ns / node |\n";
+    std::cout << "| --- | --- | --- | --- | --- |\n";
+
+    BenchRow("Chronological backtracking", order, [](AssocHeuristics &) { });
+    BenchRow("Backjumping", order, [](AssocHeuristics &h) { h.SetBackjumping(true); });
+    BenchRow("Backjumping + nogood learning", order, [](AssocHeuristics &h) { h.SetNogoodLearning(1 << 20); });
+    BenchRow("All-different filtering", order, [](AssocHeuristics &h) { h.SetAllDifferent(true); });
+    BenchRow("Element order pruning", order, [](AssocHeuristics &h) { h.SetElementOrderPruning(true); });
+    BenchRow("Backjumping + element order pruning", order, [](AssocHeuristics &h) {
+        h.SetBackjumping(true);
+        h.SetElementOrderPruning(true);
+    });
+    BenchRow("Abelian mode + element order pruning", order, [](AssocHeuristics &h) {
+        h.SetAbelian(true);
+        h.SetElementOrderPruning(true);
+    });
+
+    return 0;
+}
+
+/**
+ * @brief Prints one table for each abelian group of the order, without search.
+ */
+int Abelian(int order) {
+    std::vector<std::vector<int>> groups = AbelianGroups::InvariantFactors(order);
+
+    for(const std::vector<int> &factors : groups) {
+        std::vector<uint8_t> cayley = AbelianGroups::Table(factors);
+        std::cout << AbelianGroups::Name(factors) << '\n';
+        WorkUnit::WriteTable(std::cout, order, &cayley[0]);
+        std::cout << '\n';
+    }
+
+    std::cout << "Abelian groups of order " << order << ": " << groups.size() << '\n';
+
+    return 0;
+}
+
+/**
+ * @brief Prints the tables of the groups with the given properties.
+ * (See PropertySpec for the format.)
+ */
+int Find(int order, const std::string &properties) {
+    AssocHeuristics heuristics(order);
+    heuristics.SetElementOrderPruning(true);
+    heuristics.SetPropertySpec(PropertySpec::Parse(properties));
+    long count = 0;
+
+    while(true) {
+        heuristics.Next();
+
+        if (!heuristics.Found()) {
+            break;
+        }
+
+        WorkUnit::WriteTable(std::cout, order, heuristics.GetCayley());
+        std::cout << '\n';
+        count++;
+    }
+
+    std::cout << "Tables: " << count << ", nodes: " << heuristics.GetNodeCount() << '\n';
+
+    return 0;
+}
+
+/**
+ * @brief Counts the groups of the order (with element order pruning),
+ * and reports the progress periodically to "log". The tree size is
+ * estimated again from the current node every 10 reports.
+ */
+int Count(int order, double interval, std::ostream &log) {
+    AssocHeuristics heuristics(order);
+    SearchProgress progress(log, interval);
+
+    heuristics.SetElementOrderPruning(true);
+    double estimate = heuristics.EstimateTreeSize(1000, 1);
+    log << "Estimated tree size: " << (uint64_t)estimate << " nodes (1000 probes)" << std::endl;
+
+    progress.SetEstimate(estimate);
+    progress.SetReestimation(10 * interval, 100);
+    heuristics.SetProgress(&progress);
+    uint64_t count = heuristics.Count();
+
+    progress.Report(heuristics.GetNodeCount(), 1.0, true);
+    std::cout << "Groups of order " << order << ": " << count << " tables, "
+        << heuristics.GetNodeCount() << " nodes\n";
+
+    return 0;
+}
+
+/**
+ * @brief Prints one Latin square per isotopy or main class, and checks
+ * the number of classes against the known values (orders 1 -> 8).
+ */
+int Classes(int order, const std::string &kind, bool quiet) {
+    if (kind != "isotopy" && kind != "main") {
+        throw std::runtime_error("Unknown class type: " + kind + " (isotopy or main)");
+    }
+
+    bool mainClasses = kind == "main";
+    LatinClasses classes(order, mainClasses);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t count = 0;
+
+    while(true) {
+        classes.Next();
+
+        if (!classes.Found()) {
+            break;
+        }
+
+        if (!quiet) {
+            WorkUnit::WriteTable(std::cout, order, classes.GetCayley());
+            std::cout << '\n';
+        }
+
+        count++;
+    }
+
+    uint64_t known = mainClasses ? LatinClasses::KnownMainClasses(order) : LatinClasses::KnownIsotopyClasses(order);
+
+    std::cout << (mainClasses ? "Main" : "Isotopy") << " classes of order " << order << ": " << count
+        << " (nodes: " << classes.GetNodeCount() << ", pruned rectangles: " << classes.GetPrunedCount()
+        << ", " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s)\n";
+
+    if (known > 0) {
+        std::cout << "Known value: " << known << (known == count ? " - OK" : " - MISMATCH") << '\n';
+
+        return known == count ? 0 : 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Computes the automorphism group of each table in the input.
+ * (Tables in the format of the merge command.)
+ */
+int PrintAutomorphisms(int order, std::istream &input) {
+    std::vector<uint8_t> cayley(order * order);
+    auto start = std::chrono::steady_clock::now();
+    long count = 0;
+
+    while(WorkUnit::ReadTable(input, order, &cayley[0])) {
+        Automorphisms automorphisms(order, &cayley[0]);
+        std::vector<uint8_t> base = automorphisms.GetBase();
+
+        std::cout << "Table " << ++count << ": |Aut| = " << automorphisms.GetOrder() << ", base:";
+
+        for(uint8_t g : base) {
+            std::cout << ' ' << (int)g;
+        }
+
+        std::cout << ", generators:\n" << automorphisms.PrintGenerators() << '\n';
+    }
+
+    std::cerr << "Tables: " << count << ", " << std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count() << " s\n";
+
+    return 0;
+}
+
+/**
+ * @brief Prints the center, the derived and central series and the
+ * composition factors of each table in the input.
+ */
+int PrintStructure(int order, std::istream &input) {
+    std::vector<uint8_t> cayley(order * order);
+    auto start = std::chrono::steady_clock::now();
+    long count = 0;
+
+    while(WorkUnit::ReadTable(input, order, &cayley[0])) {
+        Classifier classifier(order, &cayley[0]);
+        std::vector<Classifier::ElementSet> derived = classifier.GetDerivedSeries();
+        std::vector<Classifier::ElementSet> upper = classifier.GetUpperCentralSeries();
+        std::vector<Classifier::ElementSet> composition = classifier.GetCompositionSeries();
+
+        std::cout << "Table " << ++count << ": |Z| = " << classifier.GetCenter().count()
+            << ", |G'| = " << classifier.GetCommutator(derived[0], derived[0]).count();
+
+        if (derived.back().count() == 1) {
+            std::cout << ", solvable (derived length " << derived.size() - 1 << ")";
+        } else {
+            std::cout << ", not solvable";
+        }
+
+        if ((int)upper.back().count() == order) {
+            std::cout << ", nilpotent (class " << upper.size() - 1 << ")";
+        } else {
+            std::cout << ", not nilpotent";
+        }
+
+        std::cout << ", composition factors:";
+
+        for(size_t i = 1; i < composition.size(); i++) {
+            std::cout << ' ' << composition[i - 1].count() / composition[i].count();
+        }
+
+        std::cout << ", Sylow:";
+
+        for(int p : classifier.GetPrimeDivisors()) {
+            std::cout << " n_" << p << " = " << classifier.GetSylowCount(p);
+        }
+
+        std::cout << '\n';
+    }
+
+    std::cerr << "Tables: " << count << ", " << std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count() << " s\n";
+
+    return 0;
+}
+
+/**
+ * @brief Counts (and prints) the reduced Latin squares with LatinLanes.
+ */
+int LatinSquares(int order, bool print) {
+    LatinLanes lanes(order);
+    TableWriter writer;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t count;
+
+    if (print) {
+        count = lanes.Enumerate([&writer, order](const uint8_t *cayley) {
+            writer.WriteTable(order, cayley);
+            writer.Append('\n');
+
+            if (writer.GetSize() >= 65536) {
+                writer.Flush(std::cout);
+            }
+        });
+
+        writer.Flush(std::cout);
+    } else {
+        count = lanes.Count();
+    }
+
+    std::cerr << "Reduced Latin squares: " << count << ", steps: " << lanes.GetStepCount() << ", "
+        << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
     return 0;
 }
+
+/**
+ * @brief Prints random Latin squares from the Jacobson-Matthews chain.
+ */
+int RandomSquares(int order, long count, uint64_t mixingMoves, uint64_t seed, bool reduced) {
+    JacobsonMatthews sampler(order, seed);
+    auto start = std::chrono::steady_clock::now();
+
+    for(long i = 0; i < count; i++) {
+        WorkUnit::WriteTable(std::cout, order, sampler.Next(mixingMoves, reduced));
+        std::cout << '\n';
+    }
+
+    std::cerr << "Squares: " << count << ", steps: " << sampler.GetStepCount() << ", "
+        << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
+    return 0;
+}
+
+/**
+ * @brief Searches for a group with simulated annealing, and prints it if found.
+ */
+int Local(int order, uint64_t maxMoves, uint64_t seed) {
+    LocalSearch search(order, seed);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t initial = search.GetViolations();
+    bool found = search.Run(maxMoves);
+
+    if (found) {
+        WorkUnit::WriteTable(std::cout, order, search.GetCayley());
+        std::cout << '\n';
+    }
+
+    std::cout << (found ? "Group found" : "No group found") << ". Violated triples: " << initial << " -> "
+        << search.GetViolations() << ", moves: " << search.GetMoveCount() << " (accepted: "
+        << search.GetAcceptedCount() << "), " << std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count() << " s\n";
+
+    return found ? 0 : 1;
+}
+
+/**
+ * @brief Reads the first table of a file. (Format of the merge command.)
+ */
+std::vector<uint8_t> ReadFirstTable(int order, const char *path) {
+    std::ifstream input(path);
+    std::vector<uint8_t> cayley(order * order);
+
+    if (!input || !WorkUnit::ReadTable(input, order, &cayley[0])) {
+        throw std::runtime_error("Can't read a table of order " + std::to_string(order) + " from: " + path);
+    }
+
+    return cayley;
+}
+
+/**
+ * @brief Prints the extensions of N by Q. (Tables of G with N normal and G/N = Q.)
+ */
+int Extend(int normalOrder, const char *normalPath, int quotientOrder, const char *quotientPath, bool countOnly) {
+    std::vector<uint8_t> normal = ReadFirstTable(normalOrder, normalPath);
+    std::vector<uint8_t> quotient = ReadFirstTable(quotientOrder, quotientPath);
+    ExtensionSearch search(normalOrder, &normal[0], quotientOrder, &quotient[0]);
+    auto start = std::chrono::steady_clock::now();
+    long count = 0;
+
+    while(true) {
+        search.Next();
+
+        if (!search.Found()) {
+            break;
+        }
+
+        if (!countOnly) {
+            WorkUnit::WriteTable(std::cout, normalOrder * quotientOrder, search.GetCayley());
+            std::cout << '\n';
+        }
+
+        count++;
+    }
+
+    std::cout << "Extensions: " << count << " tables, |Aut(N)| = " << search.GetAutomorphismCount()
+        << ", nodes: " << search.GetNodeCount() << ", " << std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count() << " s\n";
+
+    return 0;
+}
+
+/**
+ * @brief Properties of the stored tables as CSV or binary, computed in parallel.
+ */
+int Analyze(int order, const char *path, int threads, bool binary) {
+    BatchAnalyzer analyzer(order);
+    analyzer.AddPath(path);
+    analyzer.Run(threads);
+
+    if (binary) {
+        analyzer.WriteBinary(std::cout);
+    } else {
+        analyzer.WriteCsv(std::cout);
+    }
+
+    analyzer.PrintStats(std::cerr);
+
+    return 0;
+}
+
+/**
+ * @brief Counts the labelled group tables in parallel, and optionally
+ * checks the count with the automorphism groups.
+ */
+int Labelled(int order, int threads, bool check) {
+    LabelledCounter counter(order, check);
+    counter.Run(threads);
+    counter.PrintReport(std::cout);
+
+    if (check) {
+        return counter.PrintCheck(std::cout) ? 0 : 1;
+    }
+
+    return 0;
+}
+
+int Usage() {
+    std::cerr << "Usage:\n"
+        << "  group.exe                              Interactive exploration of the groups of order 8.\n"
+        << "  group.exe shard <order> <depth> <dir>  Split the search into work unit files.\n"
+        << "  group.exe work <dir>                   Process work units until none is left.\n"
+        << "  group.exe requeue <dir> [force]        Requeue the units of dead workers. (force: all claimed units)\n"
+        << "  group.exe merge <dir> [output]         Merge the results of the finished units.\n"
+        << "  group.exe pipeline <order> <search threads> <analysis threads> [depth] [capacity]\n"
+        << "                                         Search and analyze in parallel threads.\n"
+        << "  group.exe bench <order>                Compare the search options of AssocHeuristics.\n"
+        << "  group.exe abelian <order>              Generate the abelian groups without search.\n"
+        << "  group.exe find <order> <properties>    Search for groups with the given properties.\n"
+        << "                                         Example: nonabelian,involutions=1..3,exponent=4,center=2\n"
+        << "  group.exe count <order> [interval] [stats file]\n"
+        << "                                         Count the tables with progress reports. (Default: every 10 s to stderr)\n"
+        << "  group.exe labelled <order> [threads] [check]\n"
+        << "                                         Count the tables in parallel, per first row. (Default: all cores)\n"
+        << "  group.exe classes <order> <isotopy|main> [quiet]\n"
+        << "                                         One Latin square per isotopy or main class.\n"
+        << "  group.exe automorphisms <order> [table file]\n"
+        << "                                         Aut(G) of each table. (Default: read from stdin)\n"
+        << "  group.exe structure <order> [table file]\n"
+        << "                                         Center, series and Sylow counts of each table.\n"
+        << "  group.exe analyze <order> <file or dir> [threads] [csv|binary]\n"
+        << "                                         Properties of stored tables in parallel. (Default: all cores, csv)\n"
+        << "  group.exe latin <order> [print]        Count the reduced Latin squares of order 2 -> 8.\n"
+        << "  group.exe random <order> <count> [mixing moves] [seed] [reduced]\n"
+        << "                                         Uniformly random Latin squares. (Default: order^2 moves)\n"
+        << "  group.exe local <order> [max moves] [seed]\n"
+        << "                                         Local search for a group. (Default: 10000000 moves)\n"
+        << "  group.exe extend <|N|> <N file> <|Q|> <Q file> [count]\n"
+        << "                                         Groups built from a normal subgroup and a quotient.\n";
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        return Explore();
+    }
+
+    std::string mode(argv[1]);
+
+    try {
+        if (mode == "shard" && argc == 5) {
+            Sharding sharding(argv[4]);
+            int units = sharding.CreateUnits(atoi(argv[2]), atoi(argv[3]));
+            std::cout << "Created " << units << " work units in " << argv[4] << '\n';
+            return 0;
+        }
+
+        if (mode == "work" && argc == 3) {
+            Sharding sharding(argv[2]);
+            int units = sharding.Work();
+            std::cout << "Processed " << units << " work units.\n";
+            return 0;
+        }
+
+        if (mode == "requeue" && (argc == 3 || (argc == 4 && std::string(argv[3]) == "force"))) {
+            Sharding sharding(argv[2]);
+            int units = sharding.Requeue(argc == 4);
+            std::cout << "Requeued " << units << " work units.\n";
+            return 0;
+        }
+
+        if (mode == "merge" && (argc == 3 || argc == 4)) {
+            Sharding sharding(argv[2]);
+
+            if (argc == 4) {
+                std::ofstream output(argv[3]);
+                sharding.Merge(output, std::cerr);
+            } else {
+                sharding.Merge(std::cout, std::cerr);
+            }
+
+            return 0;
+        }
+
+        if (mode == "pipeline" && argc >= 5 && argc <= 7) {
+            int order = atoi(argv[2]);
+            int depth = argc >= 6 ? atoi(argv[5]) : order - 1;
+            int capacity = argc >= 7 ? atoi(argv[6]) : 1024;
+            auto start = std::chrono::steady_clock::now();
+
+            TablePipeline pipeline(order, atoi(argv[3]), atoi(argv[4]), depth, capacity, std::cout);
+            pipeline.Run();
+
+            std::cerr << "Elapsed: " << std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count() << " s\n";
+            pipeline.PrintStats(std::cerr);
+
+            return 0;
+        }
+
+        if (mode == "bench" && argc == 3) {
+            return Bench(atoi(argv[2]));
+        }
+
+        if (mode == "abelian" && argc == 3) {
+            return Abelian(atoi(argv[2]));
+        }
+
+        if (mode == "find" && argc == 4) {
+            return Find(atoi(argv[2]), argv[3]);
+        }
+
+        if (mode == "count" && argc >= 3 && argc <= 5) {
+            double interval = argc >= 4 ? atof(argv[3]) : 10;
+
+            if (argc == 5) {
+                std::ofstream log(argv[4], std::ios::app);
+                return Count(atoi(argv[2]), interval, log);
+            }
+
+            return Count(atoi(argv[2]), interval, std::cerr);
+        }
+
+        if (mode == "labelled" && (argc == 3 || argc == 4 || (argc == 5 && std::string(argv[4]) == "check"))) {
+            return Labelled(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : 0, argc == 5);
+        }
+
+        if (mode == "classes" && (argc == 4 || (argc == 5 && std::string(argv[4]) == "quiet"))) {
+            return Classes(atoi(argv[2]), argv[3], argc == 5);
+        }
+
+        if (mode == "automorphisms" && (argc == 3 || argc == 4)) {
+            if (argc == 4) {
+                std::ifstream input(argv[3]);
+
+                if (!input) {
+                    throw std::runtime_error("Can't open file: " + std::string(argv[3]));
+                }
+
+                return PrintAutomorphisms(atoi(argv[2]), input);
+            }
+
+            return PrintAutomorphisms(atoi(argv[2]), std::cin);
+        }
+
+        if (mode == "structure" && (argc == 3 || argc == 4)) {
+            if (argc == 4) {
+                std::ifstream input(argv[3]);
+
+                if (!input) {
+                    throw std::runtime_error("Can't open file: " + std::string(argv[3]));
+                }
+
+                return PrintStructure(atoi(argv[2]), input);
+            }
+
+            return PrintStructure(atoi(argv[2]), std::cin);
+        }
+
+        if (mode == "analyze" && argc >= 4 && argc <= 6) {
+            int threads = argc >= 5 ? atoi(argv[4]) : 0;
+            std::string format = argc == 6 ? argv[5] : "csv";
+
+            if (format != "csv" && format != "binary") {
+                return Usage();
+            }
+
+            return Analyze(atoi(argv[2]), argv[3], threads, format == "binary");
+        }
+
+        if (mode == "latin" && (argc == 3 || (argc == 4 && std::string(argv[3]) == "print"))) {
+            return LatinSquares(atoi(argv[2]), argc == 4);
+        }
+
+        if (mode == "random" && argc >= 4 && argc <= 7) {
+            int order = atoi(argv[2]);
+            uint64_t moves = argc >= 5 ? strtoull(argv[4], nullptr, 10) : (uint64_t)order * order;
+            uint64_t seed = argc >= 6 ? strtoull(argv[5], nullptr, 10) : 1;
+            bool reduced = argc == 7 && std::string(argv[6]) == "reduced";
+
+            if (argc == 7 && !reduced) {
+                return Usage();
+            }
+
+            return RandomSquares(order, atol(argv[3]), moves, seed, reduced);
+        }
+
+        if (mode == "local" && argc >= 3 && argc <= 5) {
+            uint64_t moves = argc >= 4 ? strtoull(argv[3], nullptr, 10) : 10000000;
+            uint64_t seed = argc >= 5 ? strtoull(argv[4], nullptr, 10) : 1;
+
+            return Local(atoi(argv[2]), moves, seed);
+        }
+
+        if (mode == "extend" && (argc == 6 || (argc == 7 && std::string(argv[6]) == "count"))) {
+            return Extend(atoi(argv[2]), argv[3], atoi(argv[4]), argv[5], argc == 7);
+        }
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    return Usage();
+}